@@ -0,0 +1,26 @@
+/*
+ * config.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+#ifndef BENCH_APP_SRC_CONFIG_H_
+#define BENCH_APP_SRC_CONFIG_H_
+
+
+/* The benchmark is built with the demo configuration, only the number of
+ * tasks is changed.
+ */
+
+#include "../../demo_app/src/config.h"
+
+/* Maximum number of tasks, the kernel included (2..32). Room for the
+ * kernel, the "ping" and "pong" tasks and BENCH_SLEEPERS sleeping tasks.
+ */
+
+#undef CONFIG_TASK_MAX
+#define CONFIG_TASK_MAX               16
+
+
+#endif /* BENCH_APP_SRC_CONFIG_H_ */
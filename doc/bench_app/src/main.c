@@ -0,0 +1,256 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <avr/io.h>
+
+#include "avr_mcu_section.h"
+
+#include "arch.h"
+#include "kernel_api.h"
+
+
+/****************************************************************************
+ * Private Definitions
+ ****************************************************************************/
+
+/* Number of tasks sleeping while the benchmark runs. They are never ready,
+ * thus picking the next task should cost the same for any number of them.
+ */
+
+#ifndef BENCH_SLEEPERS
+#  define BENCH_SLEEPERS    13
+#endif
+
+#if BENCH_SLEEPERS + 3 > CONFIG_TASK_MAX
+#  error "BENCH_SLEEPERS leaves no room for the kernel, ping and pong tasks."
+#endif
+
+
+/* Benchmark selection. By default the "ping" and "pong" tasks hand the
+ * cpu to each other by yield(). When BENCH_SEM is defined, they ping-pong
+ * through two semaphores instead. BENCH_VIA_KERNEL posts an event just
+ * before blocking, thus the switch goes through the kernel task, as it
+ * did before the direct task to task path.
+ */
+
+#ifdef BENCH_SEM
+#  define BENCH_PIN         PB1
+#  define BENCH_PIN_NAME    "SEM"
+#else
+#  define BENCH_PIN         PB0
+#  define BENCH_PIN_NAME    "YIELD"
+#endif
+
+
+/* The benchmark pin is set by the "ping" task just before giving up the
+ * cpu and cleared by the "pong" task just after it runs again, thus the
+ * high pulse is the cost of one switch.
+ */
+
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* simavr firmware description. The benchmark pins are traced into a VCD
+ * file, at 1 MHz one microsecond being one cpu cycle.
+ */
+
+AVR_MCU(F_CPU, "atmega1284");
+AVR_MCU_VCD_FILE("bench_app.vcd", 1000);
+
+const struct avr_mmcu_vcd_trace_t g_bench_trace[] _MMCU_ =
+{
+  { AVR_MCU_VCD_SYMBOL(BENCH_PIN_NAME), .mask = (1 << BENCH_PIN),
+    .what = (void*) &PORTB, },
+};
+
+
+#ifdef BENCH_SEM
+
+/* The "ping" task waits on the first, the "pong" task on the second. */
+
+static semaphore_t g_ping_sem;
+static semaphore_t g_pong_sem;
+
+#endif
+
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: sleeper_task
+ *
+ * Description:
+ *    Sleep for ever, only being into the task table.
+ *
+ * Input Parameters:
+ *    arg - Unused.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+static void sleeper_task(void *arg)
+{
+  (void) arg;
+
+  for (;;)
+    {
+      task_sleep(0, 0xFFFF);
+    }
+}
+
+
+/****************************************************************************
+ * Name: ping_task
+ *
+ * Description:
+ *    Raise the benchmark pin, then give up the cpu to the "pong" task.
+ *
+ * Input Parameters:
+ *    arg - Unused.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Having the same priority as the "pong" task.
+ *
+ ****************************************************************************/
+
+static void ping_task(void *arg)
+{
+  (void) arg;
+
+  for (;;)
+    {
+#ifdef BENCH_SEM
+      sem_give(&g_pong_sem);
+#  ifdef BENCH_VIA_KERNEL
+      kput_event(KERNEL_EVENT_NONE, NULL);
+#  endif
+      PORTB |= (1 << BENCH_PIN);
+      sem_take(&g_ping_sem, SEM_WAIT_FOREVER);
+#else
+#  ifdef BENCH_VIA_KERNEL
+      kput_event(KERNEL_EVENT_NONE, NULL);
+#  endif
+      PORTB |= (1 << BENCH_PIN);
+      yield();
+#endif
+    }
+}
+
+
+/****************************************************************************
+ * Name: pong_task
+ *
+ * Description:
+ *    Clear the benchmark pin, then give up the cpu to the "ping" task.
+ *
+ * Input Parameters:
+ *    arg - Unused.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Having the same priority as the "ping" task.
+ *
+ ****************************************************************************/
+
+static void pong_task(void *arg)
+{
+  (void) arg;
+
+  for (;;)
+    {
+#ifdef BENCH_SEM
+      sem_take(&g_pong_sem, SEM_WAIT_FOREVER);
+      PORTB &= ~(1 << BENCH_PIN);
+      sem_give(&g_ping_sem);
+#else
+      PORTB &= ~(1 << BENCH_PIN);
+      yield();
+#endif
+    }
+}
+
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: main
+ *
+ * Description:
+ *    Main function.
+ *    Create the benchmark tasks and start the kernel.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Should never return.
+ *
+ ****************************************************************************/
+
+int main(void)
+{
+  int i;
+
+  /* Initializations. */
+
+  DDRB |= (1 << BENCH_PIN);
+  PORTB &= ~(1 << BENCH_PIN);
+
+  /* Kernel initialization. */
+
+  kernel_init();
+
+#ifdef BENCH_SEM
+  sem_init(&g_ping_sem);
+  sem_init(&g_pong_sem);
+#endif
+
+  /* Creating tasks. The sleepers are created first, thus they are
+   * already sleeping when the benchmark starts.
+   */
+
+  for (i = 0; i < BENCH_SLEEPERS; i++)
+    {
+      task_create("sleeper", sleeper_task, NULL, 0);
+    }
+
+  task_create("ping", ping_task, NULL, 0);
+  task_create("pong", pong_task, NULL, 0);
+
+  /* Starting the never-ending kernel loop. */
+
+  kernel_start();
+
+  /* Should not reach here. */
+
+  return 0;
+}
@@ -12,7 +12,9 @@
 /* TODO #errors here for undefined. */
 /* TODO #error*/
 
-#define CONFIG_MAX_EVENTS     50
+/* Kernel event buffer capacity, power of two (2..128). */
+
+#define CONFIG_MAX_EVENTS     32
 
 /* TODO */
 
@@ -22,10 +24,69 @@
 
 #define CONFIG_TASK_MAX_NAME  10
 
+/* Task priority levels (1..8), 0 is the highest priority. */
+
+#define CONFIG_TASK_PRIORITIES        8
+#define CONFIG_TASK_DEFAULT_PRIORITY  4
+
+/* Maximum number of tasks, the kernel included (2..32). */
+
+#define CONFIG_TASK_MAX               8
+
 /* TODO */
 
 //#define CONFIG_STACK_START_ADDRESS 0x897 // TODO: find this automatically.
 #define CONFIG_STACK_DEFAULT_SIZE 128
 
+/* Stack preparation at task creation, the default clears it. Painting
+ * allows measuring the stack usage, the lazy mode makes the boot faster.
+ * Only one of them can be defined.
+ */
+
+//#define CONFIG_STACK_PAINT
+//#define CONFIG_STACK_PAINT_BYTE 0xA5
+//#define CONFIG_STACK_INIT_LAZY
+
+/* Stack overflow detection, a canary word is checked on each switch. */
+
+//#define CONFIG_STACK_CHECK
+
+/* UART ports driven, each one having its own buffers (1..2 on ATmega1284,
+ * 1 on ATmega328).
+ */
+
+#define CONFIG_UART_PORTS           1
+
+/* UART transmit ring buffer, power of two (2..128). A blocked writer is
+ * woken when the ring drains to the low-water mark.
+ */
+
+#define CONFIG_UART_TX_BUFFER_SIZE  32
+#define CONFIG_UART_TX_LOW_WATER    8
+
+/* UART receive ring buffer, power of two (2..128), always armed. */
+
+#define CONFIG_UART_RX_BUFFER_SIZE  32
+
+/* System tick length, in timer counts (F_CPU / 256), 1..0x7FFF, the same
+ * in periodic and tickless modes. When not defined, the tick is one timer
+ * overflow (65536 counts, about 16.8s @ 1MHz). 39 is about 10ms @ 1MHz.
+ */
+
+//#define CONFIG_SYSTICK_PERIOD 39
+
+/* Tickless idle. The systick timer wakes up the cpu only when the first
+ * sleeping task has to run. Needs CONFIG_SYSTICK_PERIOD.
+ */
+
+//#define CONFIG_TICKLESS
+
+/* Preemptive scheduling. A running task is switched out from the systick
+ * interrupt after its time slice (in ticks) is used up.
+ */
+
+//#define CONFIG_PREEMPTION
+#define CONFIG_TASK_DEFAULT_QUANTUM   1
+
 
 #endif /* SRC_KERNEL_INCLUDE_CONFIG_H_ */
@@ -23,6 +23,7 @@ void arch_go_idle(void);
 
 /* Stack. */
 void stack_init(void **stack);
+void stack_limit(void **limit);
 
 /* Timers. */
 void arch_reset_watchdog(void);
@@ -32,6 +33,8 @@ void arch_stop_watchdog(void);
 void arch_start_systick(void);
 void arch_configure_systick(void);
 void arch_stop_systick(void);
+void arch_systick_suppress(unsigned int ticks);
+unsigned int arch_systick_update(void);
 
 
 /****************************************************************************
@@ -39,9 +42,13 @@ void arch_stop_systick(void);
  ****************************************************************************/
 
 /* UART */
-void arch_uart_init(void);
-void arch_uart_byte_send(unsigned char c);
-void arch_uart_byte_recv(unsigned char *c);
+#define ARCH_UART_PORTS   2
+
+void arch_uart_init(int port);
+void arch_uart_byte_send(int port, unsigned char c);
+void arch_uart_tx_start(int port);
+void arch_uart_tx_stop(int port);
+void arch_uart_byte_recv(int port, unsigned char *c);
 
 
 #endif /* SRC_ARCH_ATMEGA1284_ARCH_H_ */
@@ -11,20 +11,78 @@
 
 #include "uart.h"
 
-ISR(TIMER1_OVF_vect)
+/* Systick vector and ticks accounting. In tickless mode many ticks
+ * could elapse since the last one, when idle. A given tick length is
+ * generated by the compare, otherwise the tick is the timer overflow.
+ */
+
+#if defined(CONFIG_TICKLESS)
+#  define SYSTICK_vect      TIMER1_COMPA_vect
+#  define SYSTICK_ACCOUNT() systick_add(arch_systick_update())
+#elif defined(CONFIG_SYSTICK_PERIOD)
+#  define SYSTICK_vect      TIMER1_COMPA_vect
+#  define SYSTICK_ACCOUNT() systick()
+#else
+#  define SYSTICK_vect      TIMER1_OVF_vect
+#  define SYSTICK_ACCOUNT() systick()
+#endif
+
+
+#ifdef CONFIG_PREEMPTION
+ISR(SYSTICK_vect, ISR_NAKED)
+{
+  /* Save the whole context of the interrupted task, since it could be
+   * preempted. Then, clear the zero register expected by C code.
+   */
+
+  SAVE_CONTEXT();
+  asm volatile ("clr r1");
+
+  SYSTICK_ACCOUNT();
+
+  /* Switch to kernel if the time slice of the task was used up. */
+
+  context_preempt();
+
+  /* Restore context based on stack pointer, from the same task or from
+   * the kernel.
+   */
+
+  RESTORE_CONTEXT();
+  ISR_RETURN();
+}
+#else
+ISR(SYSTICK_vect)
 {
-  systick();
+  SYSTICK_ACCOUNT();
 }
+#endif
 
 
 ISR(USART0_RX_vect)
 {
   volatile char byte = UDR0;
-  drv_uart_rx_irq(byte);
+  drv_uart_rx_irq(0, byte);
+}
+
+ISR(USART0_UDRE_vect)
+{
+  drv_uart_tx_irq(0);
+}
+
+
+/* USART1 is wired only when its port is driven. */
+
+#if CONFIG_UART_PORTS > 1
+ISR(USART1_RX_vect)
+{
+  volatile char byte = UDR1;
+  drv_uart_rx_irq(1, byte);
 }
 
-ISR(USART0_TX_vect)
+ISR(USART1_UDRE_vect)
 {
-  drv_uart_tx_irq();
+  drv_uart_tx_irq(1);
 }
+#endif
 
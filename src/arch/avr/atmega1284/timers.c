@@ -14,6 +14,47 @@
 #include "kernel_api.h"
 
 
+/* Systick period.
+ *
+ * CONFIG_SYSTICK_PERIOD is the tick length, expressed in timer counts
+ * (F_CPU / 256). When it is defined, Timer/Counter1 Output Compare A
+ * generates the tick, in both the periodic and the tickless modes, thus
+ * one tick has the same length in both. Otherwise, the tick is one
+ * Timer/Counter1 overflow (65536 counts).
+ */
+
+#ifdef CONFIG_SYSTICK_PERIOD
+#  if CONFIG_SYSTICK_PERIOD < 1 || CONFIG_SYSTICK_PERIOD > 0x7FFF
+#    error "CONFIG_SYSTICK_PERIOD must be between 1 and 0x7FFF."
+#  endif
+#endif
+
+
+/* Tickless mode.
+ *
+ * Timer/Counter1 is free running and the compare is moved forward by
+ * CONFIG_SYSTICK_PERIOD timer counts on each tick. Before going idle, the
+ * compare is moved further, up to the first sleeping task deadline, thus
+ * the cpu is not woken up by useless ticks.
+ */
+
+#ifdef CONFIG_TICKLESS
+
+#ifndef CONFIG_SYSTICK_PERIOD
+#  error "CONFIG_TICKLESS needs CONFIG_SYSTICK_PERIOD, the tick length."
+#endif
+
+/* Most ticks which can be skipped with one compare. */
+
+#define SYSTICK_MAX_TICKS ((0xFFFF / CONFIG_SYSTICK_PERIOD) - 1)
+
+/* Timer count at the last accounted tick. */
+
+static uint16_t g_systick_last;
+
+#endif /* CONFIG_TICKLESS */
+
+
 void arch_reset_watchdog(void)
 {
   //TODO
@@ -52,6 +93,13 @@ void arch_start_systick(void)
   /* Reset the values. */
 
   TCNT1 = (uint16_t) 0;
+
+#if defined(CONFIG_TICKLESS)
+  g_systick_last = 0;
+  OCR1A = (uint16_t) CONFIG_SYSTICK_PERIOD;
+#elif defined(CONFIG_SYSTICK_PERIOD)
+  OCR1A = (uint16_t) (CONFIG_SYSTICK_PERIOD - 1);
+#endif
 }
 
 
@@ -80,11 +128,22 @@ void arch_configure_systick(void)
      (0 << CS11)  |   /* Clock Select */
      (0 << CS10);     /* Clock Select */
 
+#ifdef CONFIG_SYSTICK_PERIOD
+  TIMSK1 = (uint8_t) \
+    (1 << OCIE1A);    /* Timer/Cnt1 Output Compare Match A */
+#else
   TIMSK1 = (uint8_t) \
 //    (0 << TICIE1) |   /* Timer/Cnt1 Input Capture Interrupt */
 //    (0 << OCIE1A) |   /* Timer/Cnt1 Output Compare Match */
 //    (0 << OCIE1B) |   /* Timer/Cnt1 Output Compare Match */
     (1 << TOIE1);     /* Timer/Cnt1 Overflow Interrupt Enable */
+#endif
+
+#if defined(CONFIG_SYSTICK_PERIOD) && !defined(CONFIG_TICKLESS)
+  /* Periodic ticks, clear timer on compare match. */
+
+  TCCR1B |= (uint8_t) (1 << WGM12);
+#endif
 
   /* Reset the values */
 
@@ -97,3 +156,70 @@ void arch_stop_systick(void)
  /* Clearing Clock will disable timer/counter1 */
  TCCR1B &= (uint8_t) ~((1 << CS12) | (1 << CS11) | (1 << CS10));
 }
+
+
+#ifdef CONFIG_TICKLESS
+
+/****************************************************************************
+ * Name: arch_systick_suppress
+ *
+ * Description:
+ *    Move the next systick interrupt after the given number of ticks,
+ *    counting from the last accounted tick.
+ *
+ * Input Parameters:
+ *    ticks - Number of ticks. Zero, or too many ticks, means as late as
+ *            the timer can count.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called with interrupts disabled, before going idle.
+ *
+ ****************************************************************************/
+
+void arch_systick_suppress(unsigned int ticks)
+{
+  if (!ticks || ticks > SYSTICK_MAX_TICKS)
+    {
+      ticks = SYSTICK_MAX_TICKS;
+    }
+
+  OCR1A = (uint16_t) (g_systick_last + ticks * CONFIG_SYSTICK_PERIOD);
+}
+
+
+/****************************************************************************
+ * Name: arch_systick_update
+ *
+ * Description:
+ *    Count the whole ticks elapsed since the last accounted tick, then
+ *    schedule the next systick interrupt one period later.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    Number of elapsed ticks.
+ *
+ * Assumptions:
+ *    Called from the systick ISR, or with interrupts disabled.
+ *
+ ****************************************************************************/
+
+unsigned int arch_systick_update(void)
+{
+  uint16_t elapsed;
+  unsigned int ticks;
+
+  elapsed = (uint16_t) (TCNT1 - g_systick_last);
+  ticks = elapsed / CONFIG_SYSTICK_PERIOD;
+
+  g_systick_last += (uint16_t) (ticks * CONFIG_SYSTICK_PERIOD);
+  OCR1A = (uint16_t) (g_systick_last + CONFIG_SYSTICK_PERIOD);
+
+  return ticks;
+}
+
+#endif /* CONFIG_TICKLESS */
@@ -11,9 +11,6 @@
 #include <avr/io.h>
 
 
-////////////////TODO re-implement by interrupts? /////////////////////////////
-
-
 /*
  * The calculation of baudrate prescaler is done by the C
  * preprocessor inside <util/setbaud.h> which is part
@@ -27,7 +24,9 @@
 #include <util/setbaud.h>
 
 
-void arch_uart_init(void)
+/* Port 0 is USART0 and port 1 is USART1, both at the same baudrate. */
+
+void arch_uart_init(int port)
 {
   /*
    * Write the baudrate to the USART Baud Rate Register.
@@ -37,6 +36,26 @@ void arch_uart_init(void)
    * by C preprocessor inside <util/setbaud.h> header.
    */
 
+  if (port)
+    {
+      UBRR1H = UBRRH_VALUE;
+      UBRR1L = UBRRL_VALUE;
+
+#if USE_2X
+      UCSR1A |= _BV(U2X1);
+#else
+      UCSR1A &= ~(_BV(U2X1));
+#endif
+
+      /* CONFIGURE: 8 BIT DATA, 1 STOP BIT, NO PARITY */
+      UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);
+      UCSR1B = _BV(RXEN1) | _BV(TXEN1);
+
+      /* Enable Interrupts. */
+      UCSR1B |= _BV(RXCIE1);
+      return;
+    }
+
   UBRR0H = UBRRH_VALUE;
   UBRR0L = UBRRL_VALUE;
 
@@ -50,12 +69,38 @@ void arch_uart_init(void)
   UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
   UCSR0B = _BV(RXEN0) | _BV(TXEN0);
 
-  /* Enable Interrupts. */
-  UCSR0B |= _BV(RXCIE0) | _BV(TXCIE0);
+  /* Enable Interrupts. Transmitting is driven by the data register empty
+   * interrupt, enabled only while there are bytes to be sent.
+   */
+  UCSR0B |= _BV(RXCIE0);
+}
+
+
+void arch_uart_tx_start(int port)
+{
+  if (port)
+    {
+      UCSR1B |= _BV(UDRIE1);
+      return;
+    }
+
+  UCSR0B |= _BV(UDRIE0);
+}
+
+
+void arch_uart_tx_stop(int port)
+{
+  if (port)
+    {
+      UCSR1B &= ~(_BV(UDRIE1));
+      return;
+    }
+
+  UCSR0B &= ~(_BV(UDRIE0));
 }
 
 
-void arch_uart_byte_send(uint8_t c)
+void arch_uart_byte_send(int port, uint8_t c)
 {
   /* wait for empty transmit buffer */
 
@@ -63,12 +108,26 @@ void arch_uart_byte_send(uint8_t c)
 
   /* put data into buffer, sends data */
 
+  if (port)
+    {
+      UDR1 = c;
+      return;
+    }
+
   UDR0 = c;
 }
 
 
-void arch_uart_byte_recv(uint8_t *c)
+void arch_uart_byte_recv(int port, uint8_t *c)
 {
+  if (port)
+    {
+      while (!(UCSR1A & _BV(RXC1)));
+
+      *c = UDR1;
+      return;
+    }
+
   while (!(UCSR0A & _BV(RXC0)));
 
   *c = UDR0;
@@ -1,9 +1,37 @@
 
 
+/* Context frame types.
+ *
+ * The last byte pushed onto the stack by the SAVE macros records the frame
+ * type, thus RESTORE_CONTEXT() knows how many registers were saved.
+ *
+ * CONTEXT_FRAME_COOP - Voluntary switch (yield, sleep, semaphores).
+ *    Only the call-saved registers (r2-r17, r28-r29) and SREG are saved,
+ *    since the avr-gcc ABI let the caller expect the others clobbered.
+ *
+ * CONTEXT_FRAME_FULL - Switch from ISR (preemption).
+ *    All generic purpose registers and SREG are saved.
+ *
+ * A newly created task starts with a cleared full frame of
+ * CONTEXT_FRAME_FULL_SIZE bytes, the task argument being stored into the
+ * R24:R25 slots, where the avr-gcc ABI passes the first parameter.
+ * Offsets are counted from the lowest address of the frame, the type byte.
+ */
+
+#define CONTEXT_FRAME_COOP    0
+#define CONTEXT_FRAME_FULL    1
+
+#define CONTEXT_FRAME_SIZE      (1 + 18 + 1) // SREG + R2-R17,R28,R29 + type
+#define CONTEXT_FRAME_FULL_SIZE (1 + 32 + 1) // SREG + R0-R31 + type
+
+#define CONTEXT_FRAME_R25     7
+#define CONTEXT_FRAME_R24     8
+
+
 /* SAVE_CONTEXT - Save current CPU state (current running task or kernel).
  *
  * All generic purpose registers are pushed onto stack,
- * including Status Register.
+ * including Status Register. Used from ISR.
  *
  * Returning Address is already stored onto the stack at this point.
  *
@@ -51,6 +79,48 @@
           "push r29           \n\t" \
           "push r30           \n\t" \
           "push r31           \n\t" \
+          "ldi  r24, 1        \n\t" \
+          "push r24           \n\t" \
+          "in   r24, __SP_L__ \n\t" \
+          "in   r25, __SP_H__ \n\t" \
+          "sts  g_stack_pointer, r24\n\t"     \
+          "sts  g_stack_pointer + 1, r25\n\t" \
+          );
+
+
+/* SAVE_CONTEXT_COOP - Save current CPU state on a voluntary switch.
+ *
+ * Only the call-saved registers are pushed onto stack, including Status
+ * Register. It must be used only at the beginning of a naked function
+ * called from C code, where r1 is zero.
+ *
+ * Returning Address is already stored onto the stack at this point.
+ */
+
+#define SAVE_CONTEXT_COOP()         \
+  asm volatile (                    \
+          "in   r0, __SREG__  \n\t" \
+          "cli                \n\t" \
+          "push r0            \n\t" \
+          "push r2            \n\t" \
+          "push r3            \n\t" \
+          "push r4            \n\t" \
+          "push r5            \n\t" \
+          "push r6            \n\t" \
+          "push r7            \n\t" \
+          "push r8            \n\t" \
+          "push r9            \n\t" \
+          "push r10           \n\t" \
+          "push r11           \n\t" \
+          "push r12           \n\t" \
+          "push r13           \n\t" \
+          "push r14           \n\t" \
+          "push r15           \n\t" \
+          "push r16           \n\t" \
+          "push r17           \n\t" \
+          "push r28           \n\t" \
+          "push r29           \n\t" \
+          "push r1            \n\t" \
           "in   r24, __SP_L__ \n\t" \
           "in   r25, __SP_H__ \n\t" \
           "sts  g_stack_pointer, r24\n\t"     \
@@ -60,8 +130,9 @@
 
 /* RESTORE_CONTEXT - Restore a saved CPU state (task or kernel).
  *
- * All generic purpose registers are popped from the stack,
- * including Status Register.
+ * The frame type is popped first, then the generic purpose registers saved
+ * in that frame, including Status Register. For a cooperative frame, r1 is
+ * cleared back as expected by C code.
  *
  * Returning address was stored onto the stack when context switch was issued.
  *
@@ -79,6 +150,32 @@
           "cli                \n\t" \
           "out  __SP_L__, r24 \n\t" \
           "out  __SP_H__, r25 \n\t" \
+          "pop  r24           \n\t" \
+          "tst  r24           \n\t" \
+          "brne 1f            \n\t" \
+          "pop  r29           \n\t" \
+          "pop  r28           \n\t" \
+          "pop  r17           \n\t" \
+          "pop  r16           \n\t" \
+          "pop  r15           \n\t" \
+          "pop  r14           \n\t" \
+          "pop  r13           \n\t" \
+          "pop  r12           \n\t" \
+          "pop  r11           \n\t" \
+          "pop  r10           \n\t" \
+          "pop  r9            \n\t" \
+          "pop  r8            \n\t" \
+          "pop  r7            \n\t" \
+          "pop  r6            \n\t" \
+          "pop  r5            \n\t" \
+          "pop  r4            \n\t" \
+          "pop  r3            \n\t" \
+          "pop  r2            \n\t" \
+          "pop  r0            \n\t" \
+          "clr  r1            \n\t" \
+          "out  __SREG__, r0  \n\t" \
+          "rjmp 2f            \n\t" \
+          "1:                 \n\t" \
           "pop  r31           \n\t" \
           "pop  r30           \n\t" \
           "pop  r29           \n\t" \
@@ -113,6 +210,7 @@
           "pop  r0            \n\t" \
           "out  __SREG__, r0  \n\t" \
           "pop  r0            \n\t" \
+          "2:                 \n\t" \
         );
 
 
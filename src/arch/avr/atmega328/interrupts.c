@@ -12,19 +12,62 @@
 #include "uart.h"
 
 
-ISR(TIMER1_OVF_vect)
+/* Systick vector and ticks accounting. In tickless mode many ticks
+ * could elapse since the last one, when idle. A given tick length is
+ * generated by the compare, otherwise the tick is the timer overflow.
+ */
+
+#if defined(CONFIG_TICKLESS)
+#  define SYSTICK_vect      TIMER1_COMPA_vect
+#  define SYSTICK_ACCOUNT() systick_add(arch_systick_update())
+#elif defined(CONFIG_SYSTICK_PERIOD)
+#  define SYSTICK_vect      TIMER1_COMPA_vect
+#  define SYSTICK_ACCOUNT() systick()
+#else
+#  define SYSTICK_vect      TIMER1_OVF_vect
+#  define SYSTICK_ACCOUNT() systick()
+#endif
+
+
+#ifdef CONFIG_PREEMPTION
+ISR(SYSTICK_vect, ISR_NAKED)
 {
-  systick();
+  /* Save the whole context of the interrupted task, since it could be
+   * preempted. Then, clear the zero register expected by C code.
+   */
+
+  SAVE_CONTEXT();
+  asm volatile ("clr r1");
+
+  SYSTICK_ACCOUNT();
+
+  /* Switch to kernel if the time slice of the task was used up. */
+
+  context_preempt();
+
+  /* Restore context based on stack pointer, from the same task or from
+   * the kernel.
+   */
+
+  RESTORE_CONTEXT();
+  ISR_RETURN();
 }
+#else
+ISR(SYSTICK_vect)
+{
+  SYSTICK_ACCOUNT();
+}
+#endif
+
 
 ISR(USART_RX_vect)
 {
   volatile char byte = UDR0;
-  drv_uart_rx_irq(byte);
+  drv_uart_rx_irq(0, byte);
 }
 
-ISR(USART_TX_vect)
+ISR(USART_UDRE_vect)
 {
-  drv_uart_tx_irq();
+  drv_uart_tx_irq(0);
 }
 
@@ -14,6 +14,15 @@
 #include "config.h"
 
 
+/****************************************************************************
+ * External Symbols.
+ ****************************************************************************/
+
+/* End of the static data (.data, .bss, .noinit), set by the linker. */
+
+extern char __heap_start;
+
+
 /****************************************************************************
  * Public Functions.
  ****************************************************************************/
@@ -49,3 +58,33 @@ void stack_init(void **stack)
 
   *stack = ((unsigned char*) (RAMEND - CONFIG_STACK_DEFAULT_SIZE));
 }
+
+
+/****************************************************************************
+ * Name: stack_limit
+ *
+ * Description:
+ *    Get the lowest address which can be used by the task stacks, just
+ *    above the static data.
+ *
+ * Input Parameters:
+ *    Pointer to global pointer.
+ *
+ * Returned Value:
+ *    None
+ *
+ * Assumptions:
+ *    Should be called once from kernel initialization.
+ *    The heap of malloc() is not used by kernel, thus it is not accounted.
+ *
+ ****************************************************************************/
+
+void stack_limit(void **limit)
+{
+  if (!limit)
+    {
+      return;
+    }
+
+  *limit = (void*) &__heap_start;
+}
@@ -11,9 +11,6 @@
 #include <avr/io.h>
 
 
-////////////////TODO re-implement by interrupts? /////////////////////////////
-
-
 /*
  * The calculation of baudrate prescaler is done by the C
  * preprocessor inside <util/setbaud.h> which is part
@@ -27,8 +24,12 @@
 #include <util/setbaud.h>
 
 
-void arch_uart_init(void)
+/* Only port 0 exists, the upper half never asks for other ports. */
+
+void arch_uart_init(int port)
 {
+  (void) port;
+
   /*
    * Write the baudrate to the USART Baud Rate Register.
    *
@@ -50,14 +51,32 @@ void arch_uart_init(void)
   UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
   UCSR0B = _BV(RXEN0) | _BV(TXEN0);
 
-  /* Enable Interrupts. */
-  UCSR0B |= _BV(RXCIE0) | _BV(TXCIE0);
+  /* Enable Interrupts. Transmitting is driven by the data register empty
+   * interrupt, enabled only while there are bytes to be sent.
+   */
+  UCSR0B |= _BV(RXCIE0);
 }
 
 
+void arch_uart_tx_start(int port)
+{
+  (void) port;
+  UCSR0B |= _BV(UDRIE0);
+}
+
 
-void arch_uart_byte_send(uint8_t c)
+void arch_uart_tx_stop(int port)
 {
+  (void) port;
+  UCSR0B &= ~(_BV(UDRIE0));
+}
+
+
+
+void arch_uart_byte_send(int port, uint8_t c)
+{
+  (void) port;
+
   /* wait for empty transmit buffer */
 
  // while (!(UCSR0A & (1 << UDRE0)));
@@ -68,8 +87,10 @@ void arch_uart_byte_send(uint8_t c)
 }
 
 
-void arch_uart_byte_recv(uint8_t *c)
+void arch_uart_byte_recv(int port, uint8_t *c)
 {
+  (void) port;
+
   while (!(UCSR0A & _BV(RXC0)));
 
   *c = UDR0;
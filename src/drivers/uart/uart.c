@@ -2,7 +2,10 @@
 //upper half of the uart driver
 
 #include "arch.h"
+#include "cpu.h"
+#include "timers.h"
 #include "semaphore.h"
+#include "mutex.h"
 
 #include "klib.h"
 
@@ -10,90 +13,178 @@
 #include "uart.h"
 
 
-static semaphore_t drv_mtx;   /* Driver Mutex. Used to exclude other access. */
-static semaphore_t rx_irq;    /* When a byte is received this sem. is given. */
-static semaphore_t tx_irq;    /* When a byte is transmitted, this is given. */
+/* Hardware ports, the lower-half provides ARCH_UART_PORTS of them. */
 
+#if CONFIG_UART_PORTS < 1 || CONFIG_UART_PORTS > ARCH_UART_PORTS
+#  error "CONFIG_UART_PORTS exceeds the UART ports of this architecture."
+#endif
 
-static volatile struct
+
+/* Ring masks. The indexes run freely, only their difference and the low
+ * bits are used, thus the task and the ISR each own one of them. This
+ * holds only for power of two sizes, not larger than half of the
+ * unsigned char index range.
+ */
+
+#if (CONFIG_UART_RX_BUFFER_SIZE & (CONFIG_UART_RX_BUFFER_SIZE - 1)) || \
+    CONFIG_UART_RX_BUFFER_SIZE < 2 || CONFIG_UART_RX_BUFFER_SIZE > 128
+#  error "CONFIG_UART_RX_BUFFER_SIZE must be a power of two (2..128)."
+#endif
+
+#if (CONFIG_UART_TX_BUFFER_SIZE & (CONFIG_UART_TX_BUFFER_SIZE - 1)) || \
+    CONFIG_UART_TX_BUFFER_SIZE < 2 || CONFIG_UART_TX_BUFFER_SIZE > 128
+#  error "CONFIG_UART_TX_BUFFER_SIZE must be a power of two (2..128)."
+#endif
+
+#define RX_RING_MASK  (CONFIG_UART_RX_BUFFER_SIZE - 1)
+#define TX_RING_MASK  (CONFIG_UART_TX_BUFFER_SIZE - 1)
+
+
+/* A writer waiting for room is woken when the TX ring drains to the
+ * low-water mark. A mark outside of the ring would wake it on every byte,
+ * or never.
+ */
+
+#if CONFIG_UART_TX_LOW_WATER < 0 || \
+    CONFIG_UART_TX_LOW_WATER >= CONFIG_UART_TX_BUFFER_SIZE
+#  error "CONFIG_UART_TX_LOW_WATER must be lower than the TX buffer size."
+#endif
+
+
+/* Context of one port. */
+
+typedef struct
 {
-  int mode;
-  int init;
-} drv_context =
-    {
-        .mode = 0,
-        .init = 0,
-    };
+  mutex_t mtx;                  /* Port Mutex. Used to exclude other access. */
+  semaphore_t rx_irq;           /* Given when the reader packet is complete. */
+  semaphore_t tx_irq;           /* Given when TX ring drains to low-water. */
+  volatile int mode;
+  volatile int init;
+  volatile drv_uart_read_t read;
+
+  /* Receive ring, always armed. The ISR owns the head, the reader the
+   * tail.
+   */
+
+  unsigned char rx_ring[CONFIG_UART_RX_BUFFER_SIZE];
+  volatile unsigned char rx_head;      /* Next slot to be written. */
+  volatile unsigned char rx_tail;      /* Next byte to be read. */
+  volatile unsigned char rx_waiting;   /* The reader waits for data. */
+  volatile unsigned char rx_want;      /* Bytes which wake the reader. */
+  volatile unsigned int rx_last_tick;  /* Systick of the last byte. */
 
+  /* Transmit ring. The writer owns the head, the ISR the tail. */
 
-static volatile queue_t rx_queue;
-static volatile queue_t tx_queue;
+  unsigned char tx_ring[CONFIG_UART_TX_BUFFER_SIZE];
+  volatile unsigned char tx_head;      /* Next slot to be written. */
+  volatile unsigned char tx_tail;      /* Next byte to be sent. */
+  volatile unsigned char tx_waiting;   /* The writer waits for room. */
+} uart_port_t;
 
 
-void drv_uart_tx_irq(void)
+static uart_port_t g_uart_ports[CONFIG_UART_PORTS];
+
+
+/* Get the context of a port, NULL if there is no such port. */
+
+static uart_port_t *uart_getport(int port)
 {
-  sem_giveISR(&tx_irq);
+  if (port < 0 || port >= CONFIG_UART_PORTS)
+    {
+      return NULL;
+    }
+
+  return &g_uart_ports[port];
 }
 
 
-void drv_uart_rx_irq(unsigned char byte)
+void drv_uart_tx_irq(int port)
 {
-  unsigned char null;
+  uart_port_t *dev = &g_uart_ports[port];
+  unsigned char used = dev->tx_head - dev->tx_tail;
 
-  /* First, put the byte in to the receiving buffer. */
+  /* Nothing left, stop the data register empty interrupt. */
 
-  if (!kenqueue((queue_t*) &rx_queue, &byte))
+  if (!used)
     {
-      /* Something went wrong, maybe the receiving buffer was not
-       * allocated or is full.
-       *
-       * Nothing more to do in this case, just drop the byte.
-       */
+      arch_uart_tx_stop(port);
       return;
     }
 
-  /* Handle ENTER key for TEXT mode. */
+  arch_uart_byte_send(port, dev->tx_ring[dev->tx_tail & TX_RING_MASK]);
+  dev->tx_tail++;
+  used--;
+
+  /* Wake the writer once, when there is enough room again. */
 
-  if (drv_context.mode == DRVCTRL_UART_MODE_TXT)
+  if (dev->tx_waiting && used <= CONFIG_UART_TX_LOW_WATER)
     {
-      /* In TEXT mode, the buffer need to have the null terminator
-       * after the '\n', therefore the buffer need to have at least
-       * one free byte after the '\n', were the null terminator
-       * will be appended.
-       *
-       * Otherwise, if the buffer is full and no '\n' was received,
-       * append the null terminator and give the event.
-       */
+      dev->tx_waiting = 0;
+      sem_giveISR(&dev->tx_irq);
+    }
+}
 
-      if (byte == '\n' || byte == '\r' ||
-          kqueue_get_freesize((queue_t*) &rx_queue) == 1)
-        {
-          null = '\0';
-          kenqueue((queue_t*) &rx_queue, &null);
-          sem_giveISR(&rx_irq);
-          return;
-        }
+
+void drv_uart_rx_irq(int port, unsigned char byte)
+{
+  uart_port_t *dev = &g_uart_ports[port];
+  unsigned char used = dev->rx_head - dev->rx_tail;
+
+  /* Keep the byte even if no read is pending. If the ring is full, there
+   * is nothing more to do, just drop the byte.
+   */
+
+  if (used == CONFIG_UART_RX_BUFFER_SIZE)
+    {
+      return;
     }
-  else
+
+  dev->rx_ring[dev->rx_head & RX_RING_MASK] = byte;
+  dev->rx_head++;
+  used++;
+
+#ifdef CONFIG_TICKLESS
+  /* This byte could wake up the cpu from idle, before the ticks elapsed
+   * meanwhile are accounted. Account them first, thus the idle gap is
+   * measured from the real arrival time.
+   */
+
+  systick_add(arch_systick_update());
+#endif
+
+  dev->rx_last_tick = (unsigned int) getsysticks();
+
+  /* Wake the reader once, when its packet could be complete. The idle gap
+   * and the timeout are measured by the reader itself, waiting in time.
+   */
+
+  if (!dev->rx_waiting)
     {
-      /* Here is the BINARY mode.
-       * Check if the buffer is full and give the event.
-       */
+      return;
+    }
 
-      if (kqueue_get_freesize((queue_t*) &rx_queue) == 0)
-        {
-          sem_giveISR(&rx_irq);
-          return;
-        }
+  if (used >= dev->rx_want || used == CONFIG_UART_RX_BUFFER_SIZE ||
+      (dev->mode == DRVCTRL_UART_MODE_TXT &&
+       (byte == '\n' || byte == '\r')))
+    {
+      dev->rx_waiting = 0;
+      sem_giveISR(&dev->rx_irq);
     }
 }
 
 
-int drv_init_uart(void)
+int drv_init_uart(int port)
 {
+  uart_port_t *dev = uart_getport(port);
+
+  if (!dev)
+    {
+      return DRV_STATUS_ERROR;
+    }
+
   /* Guard against multiple initialization. */
 
-  if (drv_context.init)
+  if (dev->init)
     {
       /* The driver was already initiated. */
 
@@ -102,44 +193,44 @@ int drv_init_uart(void)
 
   /* Lower-half init. function. */
 
-  arch_uart_init();
+  arch_uart_init(port);
 
-  sem_init(&drv_mtx);
-  sem_init(&rx_irq);
-  sem_init(&tx_irq);
+  mutex_init(&dev->mtx);
+  sem_init(&dev->rx_irq);
+  sem_init(&dev->tx_irq);
 
   /* Configure default settings. */
 
-  drv_context.mode = DRVCTRL_UART_MODE_TXT;
-
-  /* Since there is no resource free first time,
-   * give it here, at init. time.
-   */
-
-  sem_give(&drv_mtx);
+  dev->mode = DRVCTRL_UART_MODE_TXT;
 
   /* Marking the driver as initialized. */
 
-  drv_context.init = 1;
+  dev->init = 1;
 
   return DRV_STATUS_SUCCESS;
 }
 
 
 
-int drv_open_uart(void)
+int drv_open_uart(int port)
 {
-  /* Check if the driver is already used, by trying to take
-   * the mutex semaphore.
+  uart_port_t *dev = uart_getport(port);
+
+  if (!dev)
+    {
+      return DRV_STATUS_ERROR;
+    }
+
+  /* Check if the driver is already used, by trying to lock the mutex.
    * Note: Using no blocking here, only test if the mutex is used.
    */
 
-  switch (sem_take(&drv_mtx, SEM_WAIT_NO))
+  switch (mutex_trylock(&dev->mtx))
     {
-      case SEM_STATUS_TOOK:
+      case MUTEX_STATUS_SUCCESS:
         return DRV_STATUS_SUCCESS;
 
-      case SEM_STATUS_BUSY:
+      case MUTEX_STATUS_BUSY:
         return DRV_STATUS_BUSY;
 
       default:
@@ -150,110 +241,255 @@ int drv_open_uart(void)
 }
 
 
-void drv_close_uart(void)
+void drv_close_uart(int port)
 {
+  uart_port_t *dev = uart_getport(port);
+
+  if (!dev)
+    {
+      return;
+    }
+
   //TODO: Rx Tx operations in pending ??
 
   /* Release the uart resource. */
 
-  sem_give(&drv_mtx);
+  mutex_unlock(&dev->mtx);
 
   return;
 }
 
 
-int drv_read_uart(void *data, unsigned int size)
+int drv_read_uart(int port, void *data, unsigned int size)
 {
-  int retval = DRV_STATUS_ERROR;
+  uart_port_t *dev = uart_getport(port);
+  unsigned char *out = data;
+  unsigned char byte;
+  unsigned int count = 0;
+  unsigned int max = size;
+  unsigned int goal;
+  unsigned int start;
+  unsigned int elapsed;
+  unsigned int wait;
+  int line = 0;
+  SEM_STATUS_T status;
 
   /* Check if data pointer is not NULL and the driver
    * was initialized before.
    */
 
-  if (!data || !size || !drv_context.init)
+  if (!dev || !data || !size || !dev->init)
     {
-      return retval;
+      return DRV_STATUS_ERROR;
     }
 
-  /* Create a queue over memory location pointed by 'data' with size of
-   * one element of 1 byte.
-   *
-   * The ISR will receive one byte at a time and will write it
-   * directly into location pointed by data.
-   */
+  /* In TEXT mode, one byte is kept for the null terminator. */
 
-  kqueue_init((queue_t*) &rx_queue, data, size, 1);
+  if (dev->mode == DRVCTRL_UART_MODE_TXT)
+    {
+      max--;
+    }
 
-  /* Waiting for ISR / lower-half to give the semaphore.
-   * This will happens when the 'buffer' is full, or when ENTER (CR/LF)
-   * key was received, depending on driver configuration.
+  /* Without a byte count, the read completes when the buffer is filled,
+   * or earlier by CR/LF in TEXT mode, by the idle gap or by the timeout.
    */
 
-  if (sem_take(&rx_irq, SEM_WAIT_FOREVER) == SEM_STATUS_ERROR)
+  goal = dev->read.count;
+  if (!goal || goal > max)
     {
-      kqueue_destroy((queue_t*) &rx_queue);
-      return retval;
+      goal = max;
     }
 
+  disable_interrupts();
+  start = (unsigned int) getsysticks();
+  enable_interrupts();
 
-  retval = kqueue_get_usedsize((queue_t*) &rx_queue);
-  if (retval < 0)
+  for (;;)
     {
-      retval = DRV_STATUS_ERROR;
+      /* Copy out whatever is buffered. In TEXT mode, stop after the ENTER
+       * key (CR/LF).
+       */
+
+      while (count < max && dev->rx_tail != dev->rx_head)
+        {
+          byte = dev->rx_ring[dev->rx_tail & RX_RING_MASK];
+          dev->rx_tail++;
+          out[count++] = byte;
+
+          if (dev->mode == DRVCTRL_UART_MODE_TXT &&
+              (byte == '\n' || byte == '\r'))
+            {
+              line = 1;
+              break;
+            }
+        }
+
+      if (line || count >= goal)
+        {
+          break;
+        }
+
+      /* Find how long to wait, for the idle gap after the last byte and
+       * for the overall timeout. Zero means waiting for the ISR only.
+       */
+
+      wait = 0;
+      disable_interrupts();
+
+      if (dev->rx_tail != dev->rx_head)
+        {
+          enable_interrupts();
+          continue;
+        }
+
+      if (dev->read.idle && count)
+        {
+          elapsed = (unsigned int) getsysticks() - dev->rx_last_tick;
+          if (elapsed >= dev->read.idle)
+            {
+              enable_interrupts();
+              break;
+            }
+
+          wait = dev->read.idle - elapsed;
+        }
+
+      if (dev->read.timeout)
+        {
+          elapsed = (unsigned int) getsysticks() - start;
+          if (elapsed >= dev->read.timeout)
+            {
+              enable_interrupts();
+              break;
+            }
+
+          elapsed = dev->read.timeout - elapsed;
+          if (!wait || elapsed < wait)
+            {
+              wait = elapsed;
+            }
+        }
+
+      /* Block while the packet is not complete, the ISR wakes the reader
+       * once, when enough bytes were received. The idle gap is measured
+       * only after the first byte, thus the ISR wakes the reader on it.
+       */
+
+      if (dev->read.idle && !count)
+        {
+          dev->rx_want = 1;
+        }
+      else
+        {
+          dev->rx_want = goal - count < CONFIG_UART_RX_BUFFER_SIZE ?
+                    goal - count : CONFIG_UART_RX_BUFFER_SIZE;
+        }
+      dev->rx_waiting = 1;
+      enable_interrupts();
+
+      if (wait)
+        {
+          status = sem_timedtake(&dev->rx_irq, wait);
+        }
+      else
+        {
+          status = sem_take(&dev->rx_irq, SEM_WAIT_FOREVER);
+        }
+
+      if (status == SEM_STATUS_ERROR)
+        {
+          return DRV_STATUS_ERROR;
+        }
+
+      /* After a timeout, the ISR could have given the semaphore already,
+       * just before the reader stopped waiting. Take it back.
+       */
+
+      if (status == SEM_STATUS_TIMEOUT)
+        {
+          disable_interrupts();
+          if (!dev->rx_waiting)
+            {
+              enable_interrupts();
+              sem_take(&dev->rx_irq, SEM_WAIT_NO);
+            }
+          else
+            {
+              dev->rx_waiting = 0;
+              enable_interrupts();
+            }
+        }
     }
 
-  return retval;
+  if (dev->mode == DRVCTRL_UART_MODE_TXT)
+    {
+      out[count++] = '\0';
+    }
+
+  return count;
 }
 
 
-int drv_write_uart(void *data, unsigned int size)
+int drv_write_uart(int port, void *data, unsigned int size)
 {
-  unsigned char byte;
-  int retlen = 0;
+  uart_port_t *dev = uart_getport(port);
+  unsigned char *byte = data;
+  unsigned int left = size;
+  unsigned char room;
 
   /* Check if data pointer is not NULL and the driver
    * was initialized before.
    */
 
-  if (!data || !drv_context.init)
+  if (!dev || !data || !dev->init)
     {
       return DRV_STATUS_ERROR;
     }
 
-  /* Create a non-empty queue over data. */
-
-  kqueue_init2((queue_t*) &tx_queue, data, size, 1, size);
-
-  /* For each byte in the queue, send it to lower-half and wait for
-   * transmission to complete.
+  /* Copy as many bytes as fit into the TX ring, the lower-half sends them
+   * from interrupts. Wait only while the ring is full, until it drains to
+   * the low-water mark.
    */
 
-  while (kdequeue((queue_t*) &tx_queue, (unsigned char*) &byte))
+  while (left)
     {
-      /* Send the byte to lower-half driver. */
+      disable_interrupts();
+
+      room = CONFIG_UART_TX_BUFFER_SIZE -
+             (unsigned char) (dev->tx_head - dev->tx_tail);
+      while (room && left)
+        {
+          dev->tx_ring[dev->tx_head & TX_RING_MASK] = *byte++;
+          dev->tx_head++;
+          room--;
+          left--;
+        }
 
-      arch_uart_byte_send(byte);
+      arch_uart_tx_start(port);
+      dev->tx_waiting = left != 0;
 
-      /* Wait for lower-half and peripheral transmission to complete. */
+      enable_interrupts();
 
-      if (sem_take(&tx_irq, SEM_WAIT_FOREVER) == SEM_STATUS_ERROR)
+      if (left && sem_take(&dev->tx_irq, SEM_WAIT_FOREVER) == SEM_STATUS_ERROR)
         {
           return DRV_STATUS_ERROR;
         }
-
-      retlen++;
     }
 
-  return retlen;
+  /* The bytes are queued, not yet sent. */
+
+  return size;
 }
 
 
-int drv_ctrl_uart(int operation, void *arg)
+int drv_ctrl_uart(int port, int operation, void *arg)
 {
+  uart_port_t *dev = uart_getport(port);
   int retval = DRV_STATUS_ERROR;
   int *mode = arg;
+  drv_uart_read_t *read = arg;
 
-  if (!arg)
+  if (!dev || !arg)
     {
       return retval;
     }
@@ -261,12 +497,22 @@ int drv_ctrl_uart(int operation, void *arg)
   switch (operation)
   {
     case DRVCTRL_GET:
-      *mode = drv_context.mode;
+      *mode = dev->mode;
       retval = DRV_STATUS_SUCCESS;
       break;
 
     case DRVCTRL_SET:
-      drv_context.mode = *mode;
+      dev->mode = *mode;
+      retval = DRV_STATUS_SUCCESS;
+      break;
+
+    case DRVCTRL_UART_READ_GET:
+      *read = dev->read;
+      retval = DRV_STATUS_SUCCESS;
+      break;
+
+    case DRVCTRL_UART_READ_SET:
+      dev->read = *read;
       retval = DRV_STATUS_SUCCESS;
       break;
 
@@ -3,6 +3,43 @@
 #ifndef __UART_H__
 #define __UART_H__
 
+#include "config.h"
+
+
+/* Number of UART ports driven, each one having its own context, rings and
+ * semaphores. Ports are numbered from 0, up to the ARCH_UART_PORTS of the
+ * lower half.
+ */
+
+#ifndef CONFIG_UART_PORTS
+#  define CONFIG_UART_PORTS           1
+#endif
+
+
+/* Transmit ring buffer size in bytes, power of two (2..128). Bytes written
+ * are queued here and sent by the lower half, from interrupts. A writer
+ * finding the ring full waits until it drains to CONFIG_UART_TX_LOW_WATER,
+ * which must be lower than the ring size.
+ */
+
+#ifndef CONFIG_UART_TX_BUFFER_SIZE
+#  define CONFIG_UART_TX_BUFFER_SIZE  32
+#endif
+
+#ifndef CONFIG_UART_TX_LOW_WATER
+#  define CONFIG_UART_TX_LOW_WATER    (CONFIG_UART_TX_BUFFER_SIZE / 4)
+#endif
+
+
+/* Receive ring buffer size in bytes, power of two (2..128). It is always
+ * armed, thus bytes arriving while no read is pending are kept. When it is
+ * full, the new bytes are dropped.
+ */
+
+#ifndef CONFIG_UART_RX_BUFFER_SIZE
+#  define CONFIG_UART_RX_BUFFER_SIZE  32
+#endif
+
 
 /* Diver CTRL commands supported by UART upper half driver.
  *
@@ -24,15 +61,53 @@ enum
 } DRVCTRL_UART_MODE_T;
 
 
-/* TODO add descriptions. */
+/* UART specific CTRL commands.
+ *
+ * DRVCTRL_UART_READ_GET - Get the read completion conditions into the given
+ *    drv_uart_read_t.
+ *
+ * DRVCTRL_UART_READ_SET - Set the read completion conditions from the given
+ *    drv_uart_read_t.
+ */
+
+enum
+{
+  DRVCTRL_UART_READ_GET = 16,
+  DRVCTRL_UART_READ_SET,
+} DRVCTRL_UART_T;
+
+
+/* Read completion conditions. A read returns as soon as any of them is
+ * met, also after CR\LF in text mode, or when the buffer is filled.
+ * Zero disables a condition. When all of them are zero, a read returns
+ * as the mode tells: after CR\LF in text mode, or when the buffer is
+ * filled.
+ *
+ * count - Number of bytes to be received.
+ * idle - Gap in ticks after the last received byte, ending a packet.
+ * timeout - Overall read time in ticks, the read can return no bytes.
+ */
+
+typedef struct
+{
+  unsigned int count;
+  unsigned int idle;
+  unsigned int timeout;
+} drv_uart_read_t;
+
+
+/* TODO add descriptions.
+ * Every function takes the port number first. The ISR functions are called
+ * by the lower half only for the configured ports.
+ */
 
-void drv_uart_tx_irq(void);
-void drv_uart_rx_irq(unsigned char byte);
-int drv_init_uart(void);
-int drv_open_uart(void);
-void drv_close_uart(void);
-int drv_read_uart(void *data, unsigned int size);
-int drv_write_uart(void *data, unsigned int size);
-int drv_ctrl_uart(int operation, void *arg);
+void drv_uart_tx_irq(int port);
+void drv_uart_rx_irq(int port, unsigned char byte);
+int drv_init_uart(int port);
+int drv_open_uart(int port);
+void drv_close_uart(int port);
+int drv_read_uart(int port, void *data, unsigned int size);
+int drv_write_uart(int port, void *data, unsigned int size);
+int drv_ctrl_uart(int port, int operation, void *arg);
 
 #endif /* __UART_H__ */
@@ -21,6 +21,96 @@
 #include "semaphore.h"
 #include "klib.h"
 #include "context.h"
+#include "kernel_api.h"
+
+
+/****************************************************************************
+ * Private Definitions.
+ ****************************************************************************/
+
+/* A preempted task context was saved inside the systick ISR, having the
+ * global interrupt flag cleared. Returning from interrupt enables them
+ * back, while it has no side effects for other contexts.
+ */
+
+#ifdef CONFIG_PREEMPTION
+#  define CONTEXT_RETURN()  ISR_RETURN()
+#else
+#  define CONTEXT_RETURN()  RETURN()
+#endif
+
+
+/****************************************************************************
+ * Private Functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: context_select
+ *
+ * Description:
+ *    Choose the context to be restored after a task gave up the cpu.
+ *
+ *    When no kernel event is pending, the next ready task is run directly,
+ *    skipping the round-trip through the kernel task. Otherwise, or if no
+ *    task is ready, the kernel context is chosen.
+ *
+ * Input Parameters:
+ *    None
+ *
+ * Returned Value:
+ *    None
+ *
+ * Assumptions:
+ *    Called only from the naked context switch functions, after the
+ *    context of the running task was saved and with interrupts disabled.
+ *    A task which is still running is queued as ready in both cases, the
+ *    scheduler finding it there.
+ *    A task which overflowed its stack is stopped, the kernel being run
+ *    to handle the overflow event.
+ *
+ ****************************************************************************/
+
+static void __attribute__((noinline)) context_select(void)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *next;
+
+#ifdef CONFIG_STACK_CHECK
+  task_stack_check_crit(task);
+#endif
+
+  /* A task which is still running goes at the end of its ready queue.
+   * If no other task has the same or higher priority, it is picked
+   * again and just continues.
+   */
+
+  if (task->state == TASK_STATE_RUNNING)
+    {
+      task->state = TASK_STATE_READY;
+      sched_ready_insert(task);
+    }
+
+  if (!kevent_pending())
+    {
+      next = sched_ready_pop();
+      if (next)
+        {
+          next->state = TASK_STATE_RUNNING;
+          next->slice = next->quantum;
+          g_running_task = next;
+          g_stack_pointer = next->stack_pointer;
+          return;
+        }
+    }
+
+  /* Switch from task to kernel, marking the kernel as running before
+   * its context is restored.
+   */
+
+  g_running_task = g_task_list_head;
+  g_stack_pointer = g_task_list_head->stack_pointer;
+}
 
 
 /****************************************************************************
@@ -32,7 +122,9 @@
  * Name: yield
  *
  * Description:
- *    Switch context to kernel/scheduler manually.
+ *    Give up the cpu manually. The next ready task is run directly if
+ *    there is no pending kernel event, otherwise switch context to
+ *    kernel/scheduler.
  *
  * Input Parameters:
  *    None
@@ -56,15 +148,18 @@ void yield(void)
    * The Returning Address was just stored onto the stack at this point.
    * This is used to return back to the next instruction bellow CALL
    * instruction were this function was called.
-   * Just proceed to save the context and Stack Pointer.
+   * Just proceed to save the context and Stack Pointer. Since this is a
+   * voluntary switch, only the call-saved registers are saved.
    */
 
-  SAVE_CONTEXT();
+  SAVE_CONTEXT_COOP();
 
-  /* Switch from task to kernel by exchanging the stack pointers. */
+  /* Switch from task to the next ready task, or to kernel, by exchanging
+   * the stack pointers.
+   */
 
   g_running_task->stack_pointer = (unsigned char*) g_stack_pointer;
-  g_stack_pointer = g_task_list_head->stack_pointer;
+  context_select();
 
   /* Restore context based on stack pointer. */
 
@@ -72,7 +167,7 @@ void yield(void)
 
   /* Go to the saved Returning Address. */
 
-  RETURN();
+  CONTEXT_RETURN();
 }
 
 
@@ -80,7 +175,8 @@ void yield(void)
  * Name: context_switch_to_kernel
  *
  * Description:
- *    Switch to kernel context.
+ *    Switch to kernel context, or directly to the next ready task if there
+ *    is no pending kernel event. Used by blocking functions.
  *
  * Input Parameters:
  *    None
@@ -103,15 +199,18 @@ void context_switch_to_kernel(void)
    * The Returning Address was just stored onto the stack at this point.
    * This is used to return back to the next instruction bellow CALL
    * instruction were this function was called.
-   * Just proceed to save the context and Stack Pointer.
+   * Just proceed to save the context and Stack Pointer. Since this is a
+   * voluntary switch, only the call-saved registers are saved.
    */
 
-  SAVE_CONTEXT();
+  SAVE_CONTEXT_COOP();
 
-  /* Switch from task to kernel by exchanging the stack pointers. */
+  /* Switch from task to the next ready task, or to kernel, by exchanging
+   * the stack pointers.
+   */
 
   g_running_task->stack_pointer = (unsigned char*) g_stack_pointer;
-  g_stack_pointer = g_task_list_head->stack_pointer;
+  context_select();
 
   /* Restore context based on stack pointer. */
 
@@ -119,7 +218,7 @@ void context_switch_to_kernel(void)
 
   /* Go to the saved Returning Address. */
 
-  RETURN();
+  CONTEXT_RETURN();
 }
 
 
@@ -150,10 +249,11 @@ void context_switch_to_task(void)
    * The Returning Address was just stored onto the stack at this point.
    * This is used to return back to the next instruction bellow CALL
    * instruction were this function was called.
-   * Just proceed to save the context and Stack Pointer.
+   * Just proceed to save the context and Stack Pointer. Since this is a
+   * voluntary switch, only the call-saved registers are saved.
    */
 
-  SAVE_CONTEXT();
+  SAVE_CONTEXT_COOP();
 
   /* Switch from kernel to task by exchanging the stack pointers. */
 
@@ -166,7 +266,7 @@ void context_switch_to_task(void)
 
   /* Go to the saved Returning Address. */
 
-  RETURN();
+  CONTEXT_RETURN();
 }
 
 
@@ -207,3 +307,66 @@ void exec_kernel(void)
 
   RETURN();
 }
+
+
+/****************************************************************************
+ * Name: context_preempt
+ *
+ * Description:
+ *    Consume one tick from the time slice of the running task, then switch
+ *    context to kernel if the time slice was used up.
+ *
+ * Input Parameters:
+ *    None
+ *
+ * Returned Value:
+ *    None
+ *
+ * Assumptions:
+ *    Called only from the systick ISR, between SAVE_CONTEXT() and
+ *    RESTORE_CONTEXT(), when CONFIG_PREEMPTION is defined.
+ *    The kernel itself is never preempted, neither a task which is
+ *    about to block (its state is not RUNNING anymore). The scheduler
+ *    keeps interrupts disabled while g_running_task points to a task
+ *    whose context is not restored yet.
+ *
+ ****************************************************************************/
+
+void context_preempt(void)
+{
+  task_t *task = (task_t*) g_running_task;
+
+  if (!task || task == g_task_list_head)
+    {
+      return;
+    }
+
+  if (task->state != TASK_STATE_RUNNING || !task->quantum)
+    {
+      return;
+    }
+
+  if (task->slice > 1)
+    {
+      task->slice--;
+      return;
+    }
+
+  /* Switch from task to kernel by exchanging the stack pointers.
+   * The task goes at the end of its ready queue, the kernel being marked
+   * as running before its context is restored.
+   */
+
+  task->stack_pointer = (unsigned char*) g_stack_pointer;
+
+#ifdef CONFIG_STACK_CHECK
+  if (task_stack_check_crit(task))
+#endif
+    {
+      task->state = TASK_STATE_READY;
+      sched_ready_insert(task);
+    }
+
+  g_running_task = g_task_list_head;
+  g_stack_pointer = g_task_list_head->stack_pointer;
+}
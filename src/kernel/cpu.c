@@ -6,8 +6,12 @@
  */
 
 
+#include "config.h"
 #include "arch.h"
 #include "cpu.h"
+#include "timers.h"
+#include "scheduler.h"
+#include "kernel_api.h"
 
 
 void enable_interrupts(void)
@@ -22,7 +26,49 @@ void disable_interrupts(void)
 }
 
 
+/* The cpu is put to sleep only if there is no pending event and no ready
+ * task, checked having interrupts disabled. An ISR making a task ready
+ * right before sleeping is not missed, since arch_go_idle() enables the
+ * interrupts just before the sleep instruction, then the interrupt
+ * wakes the cpu.
+ */
+
 void go_idle(void)
 {
+#ifdef CONFIG_TICKLESS
+  unsigned int ticks;
+
+  /* Tickless mode. Let the systick timer interrupt only when the first
+   * sleeping task has to be woken up, instead of on every tick.
+   */
+
+  ticks = sleepq_next_ticks();
+
+  disable_interrupts();
+  if (kevent_pending() || sched_ready_pending())
+    {
+      enable_interrupts();
+      return;
+    }
+
+  arch_systick_suppress(ticks);
+  arch_go_idle();
+
+  /* Woken up by the systick or by another interrupt. Account the ticks
+   * elapsed while sleeping in one step, then resume periodic ticks.
+   */
+
+  disable_interrupts();
+  systick_add(arch_systick_update());
+  enable_interrupts();
+#else
+  disable_interrupts();
+  if (kevent_pending() || sched_ready_pending())
+    {
+      enable_interrupts();
+      return;
+    }
+
   arch_go_idle();
+#endif
 }
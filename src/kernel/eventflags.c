@@ -0,0 +1,556 @@
+/*
+ * eventflags.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "config.h"
+#include "cpu.h"
+#include "kernel.h"
+#include "kernel_api.h"
+#include "task.h"
+#include "timers.h"
+#include "scheduler.h"
+#include "eventflags.h"
+#include "context.h"
+
+
+/****************************************************************************
+ * Private data.
+ ****************************************************************************/
+
+static void eventflags_handler(kernel_event_t *event);
+
+/* Handler of KERNEL_EVENT_FLAGS_SET, subscribed by eventflags_init(). */
+
+static kevent_handler_t g_eventflags_handler = { eventflags_handler, NULL };
+
+
+/* Groups set from ISR while the event buffer was full. They are checked
+ * on the coalesced KERNEL_EVENT_FLAGS_SET event, having no data, which is
+ * inserted by the kernel as soon as a slot is released.
+ */
+
+static eventflags_t *volatile g_eventflags_lost;
+
+
+/****************************************************************************
+ * Private functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: eventflags_match
+ *
+ * Description:
+ *  Check a wait condition against the flags.
+ *
+ * Input Parameters:
+ *  flags - Currently set flags.
+ *  mask - Flags waited for.
+ *  opts - Wait options.
+ *
+ * Returned Value:
+ *  The flags of mask which are set, if the condition is met.
+ *  0 - If the condition is not met.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+static unsigned int eventflags_match(unsigned int flags, unsigned int mask,
+                                     unsigned char opts)
+{
+  unsigned int matched = flags & mask;
+
+  if ((opts & EVENTFLAGS_ALL) && matched != mask)
+    {
+      return 0;
+    }
+
+  return matched;
+}
+
+
+/****************************************************************************
+ * Name: eventflags_wake_crit
+ *
+ * Description:
+ *  Wake up, in FIFO order, the waiting tasks whose condition is met. Each
+ *  task receives the matched flags into task->wait_value.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  Pointer to the highest priority woken task, or NULL.
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static task_t *eventflags_wake_crit(eventflags_t *group)
+{
+  task_t **link = (task_t**) &group->wait_head;
+  task_t *woken = NULL;
+  task_t *task;
+  unsigned int matched;
+
+  while ((task = *link))
+    {
+      matched = eventflags_match(group->flags, task->wait_value,
+                                 task->wait_opts);
+      if (!matched)
+        {
+          link = &task->queue_next;
+          continue;
+        }
+
+      if (task->wait_opts & EVENTFLAGS_CLEAR)
+        {
+          group->flags &= ~matched;
+        }
+
+      /* Unlink it, also end its timed wait. */
+
+      *link = task->queue_next;
+      sleepq_remove_crit(task);
+
+      task->queue_next = NULL;
+      task->wait_obj = NULL;
+      task->wait_value = matched;
+      task->state = TASK_STATE_READY;
+      sched_ready_insert(task);
+
+      if (!woken || task->priority < woken->priority)
+        {
+          woken = task;
+        }
+    }
+
+  return woken;
+}
+
+
+/****************************************************************************
+ * Name: eventflags_handler
+ *
+ * Description:
+ *  Check the waiting tasks of a group whose flags were set from ISR.
+ *  An event without data checks the groups which found the buffer full.
+ *
+ * Input Parameters:
+ *  event - KERNEL_EVENT_FLAGS_SET event from kernel.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from kernel loop only, for the subscribed event type.
+ *
+ ****************************************************************************/
+
+static void eventflags_handler(kernel_event_t *event)
+{
+  eventflags_t *group = (eventflags_t*) event->data;
+
+  if (group)
+    {
+      /* From now on, a new set inserts a new event. */
+
+      disable_interrupts();
+      group->queued = 0;
+      eventflags_wake_crit(group);
+      enable_interrupts();
+      return;
+    }
+
+  /* The lost groups, one per critical section. */
+
+  disable_interrupts();
+  while ((group = g_eventflags_lost))
+    {
+      g_eventflags_lost = group->lost_next;
+      group->lost_next = NULL;
+      group->queued = 0;
+      eventflags_wake_crit(group);
+      enable_interrupts();
+      disable_interrupts();
+    }
+  enable_interrupts();
+}
+
+
+/****************************************************************************
+ * Name: eventflags_wait_common
+ *
+ * Description:
+ *  Wait until the condition is met, optionally for a limited number of
+ *  ticks.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - Wait options.
+ *  wait - Zero for no waiting at all.
+ *  ticks - Maximum number of ticks to wait, zero for waiting forever.
+ *
+ * Returned Value:
+ *  See, eventflags_timedwait().
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+static unsigned int eventflags_wait_common(eventflags_t *group,
+                                           unsigned int mask,
+                                           unsigned char opts, int wait,
+                                           unsigned int ticks)
+{
+  task_t *task = (task_t*) g_running_task;
+  unsigned int matched;
+
+  if (!group || !task || !mask)
+    {
+      return 0;
+    }
+
+  disable_interrupts();
+
+  matched = eventflags_match(group->flags, mask, opts);
+  if (matched || !wait)
+    {
+      if (opts & EVENTFLAGS_CLEAR)
+        {
+          group->flags &= ~matched;
+        }
+
+      enable_interrupts();
+      return matched;
+    }
+
+  /* Append the task to the wait list, keeping its condition. */
+
+  sched_wait_append_crit((task_t**) &group->wait_head, task);
+
+  task->wait_obj = group;
+  task->wait_value = mask;
+  task->wait_opts = opts;
+  task->flags &= ~TASK_FLAG_TIMEDOUT;
+  task->state = TASK_STATE_FLAGS_WAIT;
+
+  if (ticks)
+    {
+      sleepq_insert_crit(task, ticks);
+    }
+
+  enable_interrupts();
+
+  /* Block until woken by a set, or until the time is over. */
+
+  context_switch_to_kernel();
+
+  if (task->flags & TASK_FLAG_TIMEDOUT)
+    {
+      task->flags &= ~TASK_FLAG_TIMEDOUT;
+      return 0;
+    }
+
+  return task->wait_value;
+}
+
+
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: eventflags_init
+ *
+ * Description:
+ *  Initialize an event flags group, having all flags cleared.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *  The first call subscribes the module to its kernel event.
+ *
+ ****************************************************************************/
+
+void eventflags_init(eventflags_t *group)
+{
+  if (!group)
+    {
+      return;
+    }
+
+  group->flags = 0;
+  group->wait_head = NULL;
+  group->queued = 0;
+  group->lost_next = NULL;
+
+  kernel_subscribe(KERNEL_EVENT_FLAGS_SET, &g_eventflags_handler);
+}
+
+
+/****************************************************************************
+ * Name: eventflags_set
+ *
+ * Description:
+ *  Set flags, waking the tasks whose condition is met. If a woken task has
+ *  a higher priority, the current task yields to it.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_set(eventflags_t *group, unsigned int mask)
+{
+  task_t *task;
+
+  if (!group)
+    {
+      return;
+    }
+
+  disable_interrupts();
+  group->flags |= mask;
+  task = eventflags_wake_crit(group);
+  enable_interrupts();
+
+  sched_yield_if_higher(task);
+}
+
+
+/****************************************************************************
+ * Name: eventflags_setISR
+ *
+ * Description:
+ *  Set flags from ISR. The waiting tasks are checked later, by the kernel,
+ *  many sets before that being handled by a single pass. If the event
+ *  buffer is full, the group is latched and checked as soon as a slot is
+ *  released, thus the wakeup is never lost.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+void eventflags_setISR(eventflags_t *group, unsigned int mask)
+{
+  if (!group)
+    {
+      return;
+    }
+
+  group->flags |= mask;
+
+  if (group->wait_head && !group->queued)
+    {
+      group->queued = 1;
+
+      if (!kput_event_crit(KERNEL_EVENT_FLAGS_SET, (void*) group))
+        {
+          group->lost_next = g_eventflags_lost;
+          g_eventflags_lost = group;
+          kput_event_once_crit(KERNEL_EVENT_FLAGS_SET);
+        }
+    }
+}
+
+
+/****************************************************************************
+ * Name: eventflags_clear
+ *
+ * Description:
+ *  Clear flags.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be cleared.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context or ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_clear(eventflags_t *group, unsigned int mask)
+{
+  if (!group)
+    {
+      return;
+    }
+
+  /* Read-modify-write of a 16 bit value, it is not atomic. */
+
+  disable_interrupts();
+  group->flags &= ~mask;
+  enable_interrupts();
+}
+
+
+/****************************************************************************
+ * Name: eventflags_get
+ *
+ * Description:
+ *  Read the flags, without waiting.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  Currently set flags.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_get(eventflags_t *group)
+{
+  unsigned int flags;
+
+  if (!group)
+    {
+      return 0;
+    }
+
+  disable_interrupts();
+  flags = group->flags;
+  enable_interrupts();
+
+  return flags;
+}
+
+
+/****************************************************************************
+ * Name: eventflags_wait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_wait(eventflags_t *group, unsigned int mask,
+                             unsigned char opts)
+{
+  return eventflags_wait_common(group, mask, opts, 1, 0);
+}
+
+
+/****************************************************************************
+ * Name: eventflags_timedwait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set, at most
+ *  a number of ticks.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If timed out or error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_timedwait(eventflags_t *group, unsigned int mask,
+                                  unsigned char opts, unsigned int ticks)
+{
+  return eventflags_wait_common(group, mask, opts, ticks != 0, ticks);
+}
+
+
+/****************************************************************************
+ * Name: eventflags_wait_cancel_crit
+ *
+ * Description:
+ *  Remove a task from the wait list of the group it waits on, when its
+ *  timed wait has expired.
+ *
+ * Input Parameters:
+ *  task - Task waiting into TASK_STATE_FLAGS_WAIT.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section, in kernel context.
+ *  The caller changes the task state.
+ *
+ ****************************************************************************/
+
+void eventflags_wait_cancel_crit(task_t *task)
+{
+  eventflags_t *group = (eventflags_t*) task->wait_obj;
+  task_t **link;
+
+  if (!group)
+    {
+      return;
+    }
+
+  for (link = (task_t**) &group->wait_head; *link;
+       link = &(*link)->queue_next)
+    {
+      if (*link == task)
+        {
+          *link = task->queue_next;
+          break;
+        }
+    }
+
+  task->queue_next = NULL;
+  task->wait_obj = NULL;
+}
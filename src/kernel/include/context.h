@@ -11,3 +11,4 @@ void __attribute__((naked)) __attribute__((noinline)) yield(void);
 void __attribute__((naked)) __attribute__((noinline)) context_switch_to_kernel(void);
 void __attribute__((naked)) __attribute__((noinline)) context_switch_to_task(void);
 void __attribute__((naked)) __attribute__((noinline)) exec_kernel(void);
+void context_preempt(void);
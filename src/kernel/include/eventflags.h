@@ -0,0 +1,235 @@
+/*
+ * eventflags.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+#ifndef SRC_KERNEL_INCLUDE_EVENTFLAGS_H_
+#define SRC_KERNEL_INCLUDE_EVENTFLAGS_H_
+
+
+/****************************************************************************
+ * Included Files.
+ ****************************************************************************/
+
+#include "config.h"
+#include "kernel.h"
+#include "task.h"
+
+
+/****************************************************************************
+ * Defined Types.
+ ****************************************************************************/
+
+/* Wait options, see eventflags_wait(). */
+
+#define EVENTFLAGS_ANY      0x00    /* Wake when any flag of mask is set. */
+#define EVENTFLAGS_ALL      0x01    /* Wake when all flags of mask are set. */
+#define EVENTFLAGS_CLEAR    0x02    /* Clear the matched flags on wake. */
+
+
+/* Event Flags Group
+ *
+ * Up to 16 flags, set and cleared from task or ISR. Tasks wait for any or
+ * all flags of a mask, linked through task->queue_next in FIFO order; the
+ * mask and options are kept into the task itself. Thus, one task waits on
+ * many conditions at once, and it is woken only once.
+ *
+ * A group set from ISR while the event buffer was full is linked through
+ * lost_next, until the kernel checks its waiting tasks.
+ */
+
+typedef volatile struct eventflags_s
+{
+  unsigned int flags;             /* Currently set flags. */
+  task_t *wait_head;              /* Waiting tasks, in FIFO order. */
+  unsigned char queued;           /* Waiting for the kernel to check it. */
+  volatile struct eventflags_s *lost_next;  /* Next group set while full. */
+} eventflags_t;
+
+
+/****************************************************************************
+ * Public function prototypes.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: eventflags_init
+ *
+ * Description:
+ *  Initialize an event flags group, having all flags cleared.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *
+ ****************************************************************************/
+
+void eventflags_init(eventflags_t *group);
+
+
+/****************************************************************************
+ * Name: eventflags_set
+ *
+ * Description:
+ *  Set flags, waking the tasks whose condition is met. If a woken task has
+ *  a higher priority, the current task yields to it.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_set(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_setISR
+ *
+ * Description:
+ *  Set flags from ISR. The waiting tasks are checked later, by the kernel,
+ *  many sets before that being handled by a single pass.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+void eventflags_setISR(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_clear
+ *
+ * Description:
+ *  Clear flags.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be cleared.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context or ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_clear(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_get
+ *
+ * Description:
+ *  Read the flags, without waiting.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  Currently set flags.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_get(eventflags_t *group);
+
+
+/****************************************************************************
+ * Name: eventflags_wait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_wait(eventflags_t *group, unsigned int mask,
+                             unsigned char opts);
+
+
+/****************************************************************************
+ * Name: eventflags_timedwait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set, at most
+ *  a number of ticks.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If timed out or error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_timedwait(eventflags_t *group, unsigned int mask,
+                                  unsigned char opts, unsigned int ticks);
+
+
+/****************************************************************************
+ * Name: eventflags_wait_cancel_crit
+ *
+ * Description:
+ *  Remove a task from the wait list of the group it waits on, when its
+ *  timed wait has expired.
+ *
+ * Input Parameters:
+ *  task - Task waiting into TASK_STATE_FLAGS_WAIT.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section, in kernel context.
+ *  The caller changes the task state.
+ *
+ ****************************************************************************/
+
+void eventflags_wait_cancel_crit(task_t *task);
+
+
+#endif /* SRC_KERNEL_INCLUDE_EVENTFLAGS_H_ */
@@ -22,6 +22,10 @@ typedef enum
   KERNEL_EVENT_SEM_GIVEN,
   KERNEL_EVENT_IPC_SENT,
   KERNEL_EVENT_IPC_RCVD,
+  KERNEL_EVENT_FLAGS_SET,
+  KERNEL_EVENT_TASK_EXITED,
+  KERNEL_EVENT_STACK_OVERFLOW,
+  KERNEL_EVENT_TYPES,               /* Number of event types, keep it last. */
 } kernel_event_type_t;
 
 
@@ -32,4 +36,18 @@ typedef volatile struct
 } kernel_event_t;
 
 
+/* Kernel Event Handler
+ *
+ * Node of the handler list of an event type, see kernel_subscribe().
+ * The node is owned by the subscriber, usually a static variable of the
+ * module, thus no memory is allocated by the kernel.
+ */
+
+typedef struct kevent_handler_s
+{
+  void (*handler)(kernel_event_t *event);   /* Called from kernel context. */
+  struct kevent_handler_s *next;            /* Next handler, same type. */
+} kevent_handler_t;
+
+
 #endif /* SRC_KERNEL_INCLUDE_KERNEL_H_ */
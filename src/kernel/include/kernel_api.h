@@ -17,6 +17,10 @@
 #include "task.h"
 #include "timers.h"
 #include "semaphore.h"
+#include "mutex.h"
+#include "eventflags.h"
+#include "msgq.h"
+#include "mailbox.h"
 #include "context.h"
 
 
@@ -38,6 +42,31 @@
  *           pointer. (char, int, void*).
  *
  * Returned Value:
+ *    1 - If the event was inserted.
+ *    0 - If the buffer is full and the event was dropped.
+ *
+ * Assumptions:
+ *    This should be called only from critical section or ISR context.
+ *
+ ****************************************************************************/
+
+int kput_event_crit(unsigned char type, void * data);
+
+
+/****************************************************************************
+ * Name: kput_event_once_crit
+ *
+ * Description:
+ *    Insert new event in the circular buffer, only if no other event of
+ *    the same type is waiting to be consumed. Used for idempotent events
+ *    without data, thus a burst of them is coalesced into one event.
+ *    If the buffer is full, the event is inserted by the kernel as soon
+ *    as a slot is released, thus it is never lost.
+ *
+ * Input Parameters:
+ *    type - Event type, lower than 16.
+ *
+ * Returned Value:
  *    none
  *
  * Assumptions:
@@ -45,7 +74,7 @@
  *
  ****************************************************************************/
 
-void kput_event_crit(unsigned char type, void * data);
+void kput_event_once_crit(unsigned char type);
 
 
 /****************************************************************************
@@ -71,6 +100,52 @@ void kput_event_crit(unsigned char type, void * data);
 void kput_event(unsigned char type, void * data);
 
 
+/****************************************************************************
+ * Name: kernel_subscribe
+ *
+ * Description:
+ *    Register a handler for an event type. The handlers of a type are
+ *    called in order of subscription, for every event of that type, just
+ *    before the scheduler runs the ready tasks.
+ *
+ * Input Parameters:
+ *    type - Event type.
+ *    node - Handler node, having the handler function set.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    Called from kernel initialization or from kernel context.
+ *    The node must remain valid while subscribed, and it can be subscribed
+ *    to a single event type.
+ *
+ ****************************************************************************/
+
+int kernel_subscribe(unsigned char type, kevent_handler_t *node);
+
+
+/****************************************************************************
+ * Name: kevent_pending
+ *
+ * Description:
+ *    Check if there are events waiting in the circular buffer.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    1 - If at least one event is waiting to be consumed.
+ *    0 - If the buffer is empty.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int kevent_pending(void);
+
+
 /****************************************************************************
  * Name: kernel_init
  *
@@ -128,7 +203,7 @@ void kernel_start(void);
  *
  * Returned Value:
  *    1 - For success.
- *    0 - For errors.
+ *    0 - For errors, if the task table is full, or there is no memory left.
  *
  * Assumptions:
  *    Task name and entry point are mandatory.
@@ -139,6 +214,27 @@ int task_create(const char *name, void (*func)(void*),
                 void *arg, int stack_size);
 
 
+/****************************************************************************
+ * Name: task_stack_usage
+ *
+ * Description:
+ *    Get the peak stack usage of a task, found from the painted pattern.
+ *
+ * Input Parameters:
+ *    tid - Given task ID. Zero for the current task.
+ *
+ * Returned Value:
+ *    Largest number of stack bytes used so far.
+ *    -1 - For errors, or if CONFIG_STACK_PAINT is not defined.
+ *
+ * Assumptions:
+ *    A function which reserved stack without writing it is not accounted.
+ *
+ ****************************************************************************/
+
+int task_stack_usage(int tid);
+
+
 /****************************************************************************
  * Name: task_getnext
  *
@@ -168,7 +264,7 @@ int task_getnext(task_t **task);
  * Name: task_getby_id
  *
  * Description:
- *    Get a pointer to a task specifying the task id.
+ *    Get a pointer to a task specifying the task id, in constant time.
  *
  * Input Parameters:
  *    tid - Given task ID.
@@ -248,16 +344,21 @@ int task_pause(int tid);
  * Name: task_destroy
  *
  * Description:
- *    Destroy a task specifying the task id.
+ *    Destroy a task specifying the task id, its memory being reused by the
+ *    next created tasks.
  *
  * Input Parameters:
- *    tid - Given task ID.
+ *    tid - Given task ID. Zero for the current task.
  *
  * Returned Value:
  *    1 - For success.
  *    0 - For errors.
+ *    For the current task, it does not return on success.
  *
  * Assumptions:
+ *    A task holding a mutex, or waiting for a mutex, a message queue or a
+ *    mailbox cannot be destroyed.
+ *    The kernel task cannot be destroyed.
  *
  ****************************************************************************/
 
@@ -285,6 +386,52 @@ int task_destroy(int tid);
 int task_sleep(unsigned int tid, const unsigned int ticks);
 
 
+/****************************************************************************
+ * Name: task_setpriority
+ *
+ * Description:
+ *    Change the priority of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    tid - Given task ID.
+ *    priority - New priority, 0 is the highest.
+ *               See, CONFIG_TASK_PRIORITIES.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int task_setpriority(int tid, unsigned char priority);
+
+
+/****************************************************************************
+ * Name: task_setquantum
+ *
+ * Description:
+ *    Change the time slice of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    tid - Given task ID.
+ *    ticks - Number of ticks the task can run before being preempted.
+ *            Zero means the task is never preempted.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    Used only when CONFIG_PREEMPTION is defined. The new value is
+ *    applied the next time the task is run.
+ *
+ ****************************************************************************/
+
+int task_setquantum(int tid, unsigned char ticks);
+
+
 /****************************************************************************
  * Name: task_getid
  *
@@ -324,13 +471,33 @@ unsigned int task_getid(void);
 void sem_init(semaphore_t *sem);
 
 
+/****************************************************************************
+ * Name: sem_init2
+ *
+ * Description:
+ *  Initialize a counting semaphore having some free resources.
+ *
+ * Input Parameters:
+ *  sem - Pointer to semaphore.
+ *  count - Initial number of free resources, up to SEM_COUNT_MAX.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+void sem_init2(semaphore_t *sem, int count);
+
+
 /****************************************************************************
  * Name: sem_take
  *
  * Description:
- *  Take the semaphore using a waiting type.
- *  This function does not block, but it will return a specific state for
- *  waiting.
+ *  Take one resource from the semaphore using a waiting type.
+ *  If none is free and waiting was requested, the current task is blocked
+ *  at the end of the wait list, until a resource is handed to it.
  *
  * Input Parameters:
  *  sem - Semaphore pointer.
@@ -338,10 +505,7 @@ void sem_init(semaphore_t *sem);
  *
  * Returned Value:
  *  SEM_STATUS_ERROR - If error encountered.
- *  SEM_STATUS_TOOK - If semaphore was took.
- *  SEM_STATUS_WAIT - If the semaphore is not available.
- *                    The task will not be called after exit, thus until
- *                    semaphore is available.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
  *  SEM_STATUS_BUSY - If the waiting type is WAIT_NO, this is returned when
  *                    the semaphore is not available.
  *
@@ -353,11 +517,38 @@ void sem_init(semaphore_t *sem);
 SEM_STATUS_T sem_take(semaphore_t *sem, SEM_WAIT_T wait);
 
 
+/****************************************************************************
+ * Name: sem_timedtake
+ *
+ * Description:
+ *  Take one resource from the semaphore, waiting at most a number of ticks.
+ *  The task waits both into the wait list of the semaphore and into the
+ *  sleep queue, thus it is woken by whichever comes first.
+ *
+ * Input Parameters:
+ *  sem - Semaphore pointer.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  SEM_STATUS_ERROR - If error encountered.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
+ *  SEM_STATUS_BUSY - If ticks is zero and the semaphore is not available.
+ *  SEM_STATUS_TIMEOUT - If no resource was handed over in time.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+SEM_STATUS_T sem_timedtake(semaphore_t *sem, unsigned int ticks);
+
+
 /****************************************************************************
  * Name: sem_giveISR
  *
  * Description:
- *  Give semaphore from ISR.
+ *  Give semaphore from ISR. The resource is handed to the first waiting
+ *  task, if any, which runs at the next context switch.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -377,7 +568,9 @@ void sem_giveISR(semaphore_t *sem);
  * Name: sem_give
  *
  * Description:
- *  Give semaphore for a resource.
+ *  Give semaphore for a resource. The resource is handed to the first
+ *  waiting task, if any. If it has a higher priority, the current task
+ *  yields to it.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -394,79 +587,795 @@ SEM_STATUS_T sem_give(semaphore_t *sem);
 
 
 /****************************************************************************
- * Name: kqueue_init
+ * Name: mutex_init
  *
  * Description:
- *    Queue initialization.
- *    This queue store the data into given array (Queue over Array).
+ *  Initialize an unlocked mutex.
  *
- * Parameters:
- *    queue - Pointer to queue object.
- *    array - Pointer to storage array.
- *    array_size - The size of storage array.
- *    element_size - The size of one element in array.
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
  *
  * Returned Value:
- *    1 - For success.
- *    0 - If error.
+ *  none
  *
  * Assumptions:
- *    none
  *
  ****************************************************************************/
 
-int kqueue_init
-    (queue_t *queue, void *array, int array_size, int element_size);
+void mutex_init(mutex_t *mutex);
 
 
 /****************************************************************************
- * Name: kenqueue
+ * Name: mutex_lock
  *
  * Description:
- *    Insert one element in storage array.
- *    This queue store the data into given array (Queue over Array).
+ *  Lock the mutex, blocking the current task until the owner unlocks it.
+ *  The owner can lock it again, then it has to unlock it as many times.
  *
- * Parameters:
- *    queue - Pointer to queue object.
- *    indata - Pointer to data to insert.
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
  *
  * Returned Value:
- *    1 - For success.
- *    0 - If error.
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
  *
  * Assumptions:
- *    none
+ *  Called only from a valid task, not from kernel, nor from ISR.
  *
  ****************************************************************************/
 
-int kenqueue(queue_t *queue, void *indata);
+MUTEX_STATUS_T mutex_lock(mutex_t *mutex);
 
 
 /****************************************************************************
- * Name: kdequeue
+ * Name: mutex_trylock
  *
  * Description:
- *    Retrieve one element in storage array.
- *    This queue store the data into given array (Queue over Array).
+ *  Lock the mutex only if it is free or already owned by the current task.
  *
- * Parameters:
- *    queue - Pointer to queue object.
- *    outdata - Pointer to variable where data will be written.
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
  *
  * Returned Value:
- *    1 - For success.
- *    0 - If error.
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_BUSY - The mutex is owned by other task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
  *
  * Assumptions:
- *    none
+ *  Called only from a valid task, not from kernel, nor from ISR.
  *
  ****************************************************************************/
 
-int kdequeue(queue_t *queue, void *outdata);
+MUTEX_STATUS_T mutex_trylock(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: mutex_unlock
+ *
+ * Description:
+ *  Unlock the mutex. When the last recursive lock is released, the mutex is
+ *  handed to the highest priority waiting task and the inherited priority
+ *  of the current task is dropped.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex was unlocked.
+ *  MUTEX_STATUS_NOT_OWNER - The current task does not own the mutex.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *  If the new owner has a higher priority, the current task yields.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_unlock(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: eventflags_init
+ *
+ * Description:
+ *  Initialize an event flags group, having all flags cleared.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *
+ ****************************************************************************/
+
+void eventflags_init(eventflags_t *group);
+
+
+/****************************************************************************
+ * Name: eventflags_set
+ *
+ * Description:
+ *  Set flags, waking the tasks whose condition is met. If a woken task has
+ *  a higher priority, the current task yields to it.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_set(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_setISR
+ *
+ * Description:
+ *  Set flags from ISR. The waiting tasks are checked later, by the kernel,
+ *  many sets before that being handled by a single pass.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be set.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+void eventflags_setISR(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_clear
+ *
+ * Description:
+ *  Clear flags.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags to be cleared.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from task context or ISR.
+ *
+ ****************************************************************************/
+
+void eventflags_clear(eventflags_t *group, unsigned int mask);
+
+
+/****************************************************************************
+ * Name: eventflags_get
+ *
+ * Description:
+ *  Read the flags, without waiting.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *
+ * Returned Value:
+ *  Currently set flags.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_get(eventflags_t *group);
+
+
+/****************************************************************************
+ * Name: eventflags_wait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_wait(eventflags_t *group, unsigned int mask,
+                             unsigned char opts);
+
+
+/****************************************************************************
+ * Name: eventflags_timedwait
+ *
+ * Description:
+ *  Block the current task until any or all flags of mask are set, at most
+ *  a number of ticks.
+ *
+ * Input Parameters:
+ *  group - Pointer to event flags group.
+ *  mask - Flags waited for.
+ *  opts - EVENTFLAGS_ANY or EVENTFLAGS_ALL, optionally or-ed with
+ *         EVENTFLAGS_CLEAR.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  The flags of mask which were set, and cleared if requested.
+ *  0 - If timed out or error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+unsigned int eventflags_timedwait(eventflags_t *group, unsigned int mask,
+                                  unsigned char opts, unsigned int ticks);
+
+
+/****************************************************************************
+ * Name: msgq_init
+ *
+ * Description:
+ *  Initialize an empty message queue.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  array - Storage array, having count * size bytes.
+ *  count - Number of messages which can be stored.
+ *  size - Size of one message in bytes.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int msgq_init(msgq_t *msgq, void *array, int count, int size);
+
+
+/****************************************************************************
+ * Name: msgq_send
+ *
+ * Description:
+ *  Send one message, blocking the current task while the queue is full.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_send(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_sendn
+ *
+ * Description:
+ *  Send many messages in one step, blocking the current task while the
+ *  queue is full, until all of them are sent.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Array of messages to be copied.
+ *  count - Number of messages.
+ *
+ * Returned Value:
+ *  Number of sent messages, which is count.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_sendn(msgq_t *msgq, const void *msgs, int count);
+
+
+/****************************************************************************
+ * Name: msgq_trysend
+ *
+ * Description:
+ *  Send one message only if there is room for it, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_trysend(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_sendISR
+ *
+ * Description:
+ *  Send one message from ISR, without waiting. A waiting receiver gets it
+ *  directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int msgq_sendISR(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_recv
+ *
+ * Description:
+ *  Receive one message, blocking the current task while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recv(msgq_t *msgq, void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_recvn
+ *
+ * Description:
+ *  Receive up to count messages in one step. The current task is blocked
+ *  only while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Buffer for count messages.
+ *  count - Maximum number of messages.
+ *
+ * Returned Value:
+ *  Number of received messages, at least one.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recvn(msgq_t *msgq, void *msgs, int count);
+
+
+/****************************************************************************
+ * Name: msgq_tryrecv
+ *
+ * Description:
+ *  Receive one message only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_tryrecv(msgq_t *msgq, void *msg);
+
+
+
+/****************************************************************************
+ * Name: mbox_init
+ *
+ * Description:
+ *  Initialize an empty mailbox.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  slots - Array of pointers, used as storage.
+ *  size - Number of slots, between 1 and 255.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int mbox_init(mailbox_t *mbox, void **slots, unsigned char size);
+
+
+/****************************************************************************
+ * Name: mbox_post
+ *
+ * Description:
+ *  Pass a buffer to the receiver, blocking the current task while the
+ *  mailbox is full. The buffer must not be used after posting it.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_post(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_trypost
+ *
+ * Description:
+ *  Pass a buffer to the receiver only if there is room, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_trypost(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_postISR
+ *
+ * Description:
+ *  Pass a buffer to the receiver from ISR, without waiting. A waiting
+ *  receiver gets it directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int mbox_postISR(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_fetch
+ *
+ * Description:
+ *  Take the oldest buffer, blocking the current task while the mailbox is
+ *  empty. The receiver becomes the owner of the buffer.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_fetch(mailbox_t *mbox);
+
+
+/****************************************************************************
+ * Name: mbox_tryfetch
+ *
+ * Description:
+ *  Take the oldest buffer only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - If the mailbox is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_tryfetch(mailbox_t *mbox);
+
+
+
+/****************************************************************************
+ * Name: kqueue_init
+ *
+ * Description:
+ *    Queue initialization.
+ *    This queue store the data into given array (Queue over Array).
+ *
+ * Parameters:
+ *    queue - Pointer to queue object.
+ *    array - Pointer to storage array.
+ *    array_size - The size of storage array, in elements.
+ *    element_size - The size of one element in array, in bytes.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kqueue_init
+    (queue_t *queue, void *array, int array_size, int element_size);
+
+
+/****************************************************************************
+ * Name: kenqueue
+ *
+ * Description:
+ *    Insert one element in storage array.
+ *    This queue store the data into given array (Queue over Array).
+ *
+ * Parameters:
+ *    queue - Pointer to queue object.
+ *    indata - Pointer to data to insert.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kenqueue(queue_t *queue, void *indata);
+
+
+/****************************************************************************
+ * Name: kdequeue
+ *
+ * Description:
+ *    Retrieve one element in storage array.
+ *    This queue store the data into given array (Queue over Array).
+ *
+ * Parameters:
+ *    queue - Pointer to queue object.
+ *    outdata - Pointer to variable where data will be written.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kdequeue(queue_t *queue, void *outdata);
+
+
+/****************************************************************************
+ * Name: kpool_init
+ *
+ * Description:
+ *    Pool initialization, all blocks being free.
+ *    The array is split into block_count blocks of block_size bytes.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    array - Pointer to storage array, of block_count * block_size bytes.
+ *    block_count - Number of blocks.
+ *    block_size - The size of one block, in bytes, at least a pointer.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_init(kpool_t *pool, void *array, int block_count, int block_size);
+
+
+/****************************************************************************
+ * Name: kpool_alloc
+ *
+ * Description:
+ *    Take one block out of the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_alloc_crit
+ *
+ * Description:
+ *    Take one block out of the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc_crit(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_free
+ *
+ * Description:
+ *    Give one block back to the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+int kpool_free(kpool_t *pool, void *block);
+
+
+/****************************************************************************
+ * Name: kpool_free_crit
+ *
+ * Description:
+ *    Give one block back to the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+int kpool_free_crit(kpool_t *pool, void *block);
+
+
+/****************************************************************************
+ * Name: kpool_get_usedcount
+ *
+ * Description:
+ *    Get the number of allocated blocks.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_usedcount(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_get_maxused
+ *
+ * Description:
+ *    Get the high-water mark, the largest number of blocks ever allocated
+ *    at the same time. Used to size the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Largest number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_maxused(kpool_t *pool);
 
 
 //TODO document these
 void systick(void);
+void systick_add(unsigned int ticks);
 unsigned long getsysticks(void);
 
 #endif /* SRC_KERNEL_INCLUDE_KERNEL_API_H_ */
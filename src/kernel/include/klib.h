@@ -96,6 +96,23 @@ typedef struct
 } queue_t;
 
 
+/* Pool of fixed-size blocks over a caller-provided array.
+ *
+ * The free blocks are linked through their first bytes, thus both
+ * allocation and free take constant time and the pool never fragments.
+ */
+
+typedef struct
+{
+  void *array_ptr;
+  void *array_end;
+  void *free_head;
+  int block_size;
+  int used_count;
+  int max_used;
+} kpool_t;
+
+
 /****************************************************************************
  * Public function prototypes.
  ****************************************************************************/
@@ -220,8 +237,8 @@ int kstreq(const char *str1, const char *str2);
  * Parameters:
  *    queue - Pointer to queue object.
  *    array - Pointer to storage array.
- *    array_size - The size of storage array.
- *    element_size - The size of one element in array.
+ *    array_size - The size of storage array, in elements.
+ *    element_size - The size of one element in array, in bytes.
  *
  * Returned Value:
  *    1 - For success.
@@ -247,8 +264,8 @@ int kqueue_init
  * Parameters:
  *    queue - Pointer to queue object.
  *    array - Pointer to storage array.
- *    array_size - The size of storage array.
- *    element_size - The size of one element in array.
+ *    array_size - The size of storage array, in elements.
+ *    element_size - The size of one element in array, in bytes.
  *    used_size - The count of already used elements.
  *
  * Returned Value:
@@ -377,4 +394,158 @@ int kqueue_get_freesize(queue_t *queue);
 void kqueue_destroy(queue_t *queue);
 
 
+/****************************************************************************
+ * Name: kpool_init
+ *
+ * Description:
+ *    Pool initialization, all blocks being free.
+ *    The array is split into block_count blocks of block_size bytes.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    array - Pointer to storage array, of block_count * block_size bytes.
+ *    block_count - Number of blocks.
+ *    block_size - The size of one block, in bytes, at least a pointer.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_init(kpool_t *pool, void *array, int block_count, int block_size);
+
+
+/****************************************************************************
+ * Name: kpool_alloc
+ *
+ * Description:
+ *    Take one block out of the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_alloc_crit
+ *
+ * Description:
+ *    Take one block out of the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc_crit(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_free
+ *
+ * Description:
+ *    Give one block back to the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+int kpool_free(kpool_t *pool, void *block);
+
+
+/****************************************************************************
+ * Name: kpool_free_crit
+ *
+ * Description:
+ *    Give one block back to the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+int kpool_free_crit(kpool_t *pool, void *block);
+
+
+/****************************************************************************
+ * Name: kpool_get_usedcount
+ *
+ * Description:
+ *    Get the number of allocated blocks.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_usedcount(kpool_t *pool);
+
+
+/****************************************************************************
+ * Name: kpool_get_maxused
+ *
+ * Description:
+ *    Get the high-water mark, the largest number of blocks ever allocated
+ *    at the same time. Used to size the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Largest number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_maxused(kpool_t *pool);
+
+
 #endif /* SRC_KERNEL_INCLUDE_KLIB_H_ */
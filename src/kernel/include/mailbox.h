@@ -0,0 +1,185 @@
+/*
+ * mailbox.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+#ifndef SRC_KERNEL_INCLUDE_MAILBOX_H_
+#define SRC_KERNEL_INCLUDE_MAILBOX_H_
+
+
+/****************************************************************************
+ * Included Files.
+ ****************************************************************************/
+
+#include "config.h"
+#include "task.h"
+
+
+/****************************************************************************
+ * Defined Types.
+ ****************************************************************************/
+
+/* Mailbox
+ *
+ * A FIFO of pointers over a caller-provided array of slots. Only the
+ * pointer is passed, thus the ownership of the buffer moves from the
+ * sender to the receiver without copying its content. Usually, the sender
+ * allocates the buffer from a pool and the receiver frees it.
+ *
+ * Receivers wait only while the mailbox is empty, senders only while it
+ * is full, both in FIFO order linked through task->queue_next. A waiting
+ * task gets its pointer delivered, or taken, by the task which wakes it.
+ */
+
+typedef volatile struct
+{
+  void **slots;                   /* Storage for the pointers. */
+  unsigned char size;             /* Number of slots. */
+  unsigned char read_idx;         /* Slot of the oldest pointer. */
+  unsigned char used;             /* Number of stored pointers. */
+  task_t *recv_head;              /* Tasks waiting to receive. */
+  task_t *send_head;              /* Tasks waiting to send. */
+} mailbox_t;
+
+
+/****************************************************************************
+ * Public function prototypes.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mbox_init
+ *
+ * Description:
+ *  Initialize an empty mailbox.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  slots - Array of pointers, used as storage.
+ *  size - Number of slots, between 1 and 255.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int mbox_init(mailbox_t *mbox, void **slots, unsigned char size);
+
+
+/****************************************************************************
+ * Name: mbox_post
+ *
+ * Description:
+ *  Pass a buffer to the receiver, blocking the current task while the
+ *  mailbox is full. The buffer must not be used after posting it.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_post(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_trypost
+ *
+ * Description:
+ *  Pass a buffer to the receiver only if there is room, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_trypost(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_postISR
+ *
+ * Description:
+ *  Pass a buffer to the receiver from ISR, without waiting. A waiting
+ *  receiver gets it directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int mbox_postISR(mailbox_t *mbox, void *msg);
+
+
+/****************************************************************************
+ * Name: mbox_fetch
+ *
+ * Description:
+ *  Take the oldest buffer, blocking the current task while the mailbox is
+ *  empty. The receiver becomes the owner of the buffer.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_fetch(mailbox_t *mbox);
+
+
+/****************************************************************************
+ * Name: mbox_tryfetch
+ *
+ * Description:
+ *  Take the oldest buffer only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - If the mailbox is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_tryfetch(mailbox_t *mbox);
+
+
+#endif /* SRC_KERNEL_INCLUDE_MAILBOX_H_ */
@@ -0,0 +1,235 @@
+/*
+ * msgq.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+#ifndef SRC_KERNEL_INCLUDE_MSGQ_H_
+#define SRC_KERNEL_INCLUDE_MSGQ_H_
+
+
+/****************************************************************************
+ * Included Files.
+ ****************************************************************************/
+
+#include "config.h"
+#include "klib.h"
+#include "task.h"
+
+
+/****************************************************************************
+ * Defined Types.
+ ****************************************************************************/
+
+/* Message Queue
+ *
+ * Fixed-size messages are copied into a queue over a caller-provided
+ * array. Receivers wait only while the queue is empty, senders only while
+ * it is full, both in FIFO order linked through task->queue_next.
+ *
+ * A sender gives its message directly into the buffer of a waiting
+ * receiver, and a receiver pulls the next pending message of a waiting
+ * sender into each freed slot. The woken task has its transfer already
+ * done, no kernel event is used and no retry is needed.
+ *
+ * Messages are copied one per critical section, thus the messages of a
+ * bulk transfer can interleave with the ones of other senders.
+ */
+
+typedef volatile struct
+{
+  queue_t queue;                  /* Stored messages. */
+  task_t *recv_head;              /* Tasks waiting to receive. */
+  task_t *send_head;              /* Tasks waiting to send. */
+} msgq_t;
+
+
+/****************************************************************************
+ * Public function prototypes.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: msgq_init
+ *
+ * Description:
+ *  Initialize an empty message queue.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  array - Storage array, having count * size bytes.
+ *  count - Number of messages which can be stored.
+ *  size - Size of one message in bytes.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int msgq_init(msgq_t *msgq, void *array, int count, int size);
+
+
+/****************************************************************************
+ * Name: msgq_send
+ *
+ * Description:
+ *  Send one message, blocking the current task while the queue is full.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_send(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_sendn
+ *
+ * Description:
+ *  Send many messages in one step, blocking the current task while the
+ *  queue is full, until all of them are sent.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Array of messages to be copied.
+ *  count - Number of messages.
+ *
+ * Returned Value:
+ *  Number of sent messages, which is count.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_sendn(msgq_t *msgq, const void *msgs, int count);
+
+
+/****************************************************************************
+ * Name: msgq_trysend
+ *
+ * Description:
+ *  Send one message only if there is room for it, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_trysend(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_sendISR
+ *
+ * Description:
+ *  Send one message from ISR, without waiting. A waiting receiver gets it
+ *  directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int msgq_sendISR(msgq_t *msgq, const void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_recv
+ *
+ * Description:
+ *  Receive one message, blocking the current task while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recv(msgq_t *msgq, void *msg);
+
+
+/****************************************************************************
+ * Name: msgq_recvn
+ *
+ * Description:
+ *  Receive up to count messages in one step. The current task is blocked
+ *  only while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Buffer for count messages.
+ *  count - Maximum number of messages.
+ *
+ * Returned Value:
+ *  Number of received messages, at least one.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recvn(msgq_t *msgq, void *msgs, int count);
+
+
+/****************************************************************************
+ * Name: msgq_tryrecv
+ *
+ * Description:
+ *  Receive one message only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_tryrecv(msgq_t *msgq, void *msg);
+
+
+#endif /* SRC_KERNEL_INCLUDE_MSGQ_H_ */
@@ -0,0 +1,170 @@
+/*
+ * mutex.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+#ifndef SRC_KERNEL_INCLUDE_MUTEX_H_
+#define SRC_KERNEL_INCLUDE_MUTEX_H_
+
+
+/****************************************************************************
+ * Included Files.
+ ****************************************************************************/
+
+#include "config.h"
+#include "task.h"
+
+
+/****************************************************************************
+ * Defined Types.
+ ****************************************************************************/
+
+/* Mutex
+ *
+ * A mutex has an owner, which can lock it again (recursive locking), and
+ * only the owner can unlock it. Waiting tasks are sorted by priority,
+ * linked through task->queue_next. While tasks are waiting, the owner runs
+ * at least at the priority of the first one (priority inheritance), thus
+ * a middle priority task cannot delay a high priority one indefinitely.
+ *
+ * The mutexes held by a task are linked through held_next, starting from
+ * task->mutex_held.
+ */
+
+typedef volatile struct mutex_s
+{
+  task_t *owner;                  /* Task holding the mutex, or NULL. */
+  unsigned char count;            /* Recursive lock count of the owner. */
+  task_t *wait_head;              /* Waiting tasks, highest priority first. */
+  volatile struct mutex_s *held_next;  /* Next mutex held by the owner. */
+} mutex_t;
+
+
+typedef enum
+{
+  MUTEX_STATUS_ERROR = 0,   /* Mutex function returned error. */
+  MUTEX_STATUS_SUCCESS,     /* Mutex locked or unlocked. */
+  MUTEX_STATUS_BUSY,        /* When trying only, mutex is owned by other. */
+  MUTEX_STATUS_NOT_OWNER,   /* Unlock requested by other than the owner. */
+} MUTEX_STATUS_T;
+
+
+/****************************************************************************
+ * Public function prototypes.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mutex_init
+ *
+ * Description:
+ *  Initialize an unlocked mutex.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+void mutex_init(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: mutex_lock
+ *
+ * Description:
+ *  Lock the mutex, blocking the current task until the owner unlocks it.
+ *  The owner can lock it again, then it has to unlock it as many times.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_lock(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: mutex_trylock
+ *
+ * Description:
+ *  Lock the mutex only if it is free or already owned by the current task.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_BUSY - The mutex is owned by other task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_trylock(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: mutex_unlock
+ *
+ * Description:
+ *  Unlock the mutex. When the last recursive lock is released, the mutex is
+ *  handed to the highest priority waiting task and the inherited priority
+ *  of the current task is dropped.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex was unlocked.
+ *  MUTEX_STATUS_NOT_OWNER - The current task does not own the mutex.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *  If the new owner has a higher priority, the current task yields.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_unlock(mutex_t *mutex);
+
+
+/****************************************************************************
+ * Name: mutex_priority_update
+ *
+ * Description:
+ *  Recompute the effective priority of a task, being the highest between
+ *  its base priority and the priorities of the tasks waiting for the
+ *  mutexes it holds. The change is propagated along the chain of owners,
+ *  when the task itself waits for a mutex.
+ *
+ * Input Parameters:
+ *  task - Task to be updated.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+void mutex_priority_update(task_t *task);
+
+
+#endif /* SRC_KERNEL_INCLUDE_MUTEX_H_ */
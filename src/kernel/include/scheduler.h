@@ -8,31 +8,209 @@
 #ifndef SRC_KERNEL_INCLUDE_SCHEDULER_H_
 #define SRC_KERNEL_INCLUDE_SCHEDULER_H_
 
+#include "kernel.h"
+#include "task.h"
+
+
+/****************************************************************************
+ * Name: scheduler_init
+ *
+ * Description:
+ *    Empty the ready queue.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called once from kernel initialization, before creating any task.
+ *
+ ****************************************************************************/
+
+void scheduler_init(void);
+
+
+/****************************************************************************
+ * Name: sched_ready_insert
+ *
+ * Description:
+ *    Append a task at the end of the ready queue of its priority.
+ *
+ * Input Parameters:
+ *    task - Task which just entered the READY state.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *    The task is not already in the ready queue.
+ *
+ ****************************************************************************/
+
+void sched_ready_insert(task_t *task);
+
+
+/****************************************************************************
+ * Name: sched_ready_remove
+ *
+ * Description:
+ *    Remove a task from the ready queue of its priority.
+ *
+ * Input Parameters:
+ *    task - Task which is leaving the READY state.
+ *
+ * Returned Value:
+ *    1 - If the task was found and removed.
+ *    0 - If the task was not in the ready queue.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    Used only for uncommon transitions (priority change, pausing), since
+ *    the list of the priority is walked.
+ *
+ ****************************************************************************/
+
+int sched_ready_remove(task_t *task);
+
+
+/****************************************************************************
+ * Name: sched_setpriority
+ *
+ * Description:
+ *    Change the effective priority of a task. A ready task is moved at the
+ *    end of its new priority queue, otherwise it will be queued with the
+ *    new priority when it becomes ready.
+ *
+ * Input Parameters:
+ *    task - Task to be changed.
+ *    priority - New priority, lower than CONFIG_TASK_PRIORITIES.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *
+ ****************************************************************************/
+
+void sched_setpriority(task_t *task, unsigned char priority);
+
+
+/****************************************************************************
+ * Name: sched_ready_pop
+ *
+ * Description:
+ *    Remove and return the first task of the highest priority ready queue.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    Pointer to task - If there is any ready task.
+ *    NULL - If no task is ready.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    Runs in constant time, no matter how many tasks exist.
+ *
+ ****************************************************************************/
+
+task_t *sched_ready_pop(void);
+
+
+/****************************************************************************
+ * Name: sched_ready_pending
+ *
+ * Description:
+ *    Check if any task is ready to run.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    1 - If at least one task is into the ready queue.
+ *    0 - If no task is ready.
+ *
+ * Assumptions:
+ *    The bitmap is one byte long, thus it is read atomically.
+ *
+ ****************************************************************************/
+
+int sched_ready_pending(void);
+
+
+/****************************************************************************
+ * Name: sched_wait_append_crit
+ *
+ * Description:
+ *    Append a task at the end of the FIFO wait list of a kernel object,
+ *    linked through task->queue_next like the ready queue.
+ *
+ * Input Parameters:
+ *    head - Wait list of the object.
+ *    task - Task which is going to wait.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    The task is not into any other queue.
+ *
+ ****************************************************************************/
+
+void sched_wait_append_crit(task_t **head, task_t *task);
+
+
+/****************************************************************************
+ * Name: sched_yield_if_higher
+ *
+ * Description:
+ *    Yield to a task just made ready, if it has a higher priority than the
+ *    running task. The kernel itself never yields.
+ *
+ * Input Parameters:
+ *    woken - Task just made ready, or NULL.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called having interrupts enabled, after the object was changed.
+ *
+ ****************************************************************************/
+
+void sched_yield_if_higher(task_t *woken);
+
 
 /****************************************************************************
  * Name: scheduler
  *
  * Description:
- *    Round Robin task scheduler.
+ *    Priority based, Round Robin task scheduler.
  *
- *    Cycle through all tasks in the task array and change their states
- *    accordingly to the received event parameter.
+ *    Run the ready tasks, highest priority first. Tasks having the
+ *    same priority are run in Round Robin order.
  *
  *    Do all possible task computation until all tasks are
- *    blocked/waiting/sleeping then return.
+ *    blocked/waiting/sleeping, or until new events arrive, then return.
  *
  * Input Parameters:
- *    event - Received Kernel Event.
+ *    none
  *
  * Returned Value:
- *    Since there is no other work or event generated by the scheduler, the
- *    return value is zero at the moment.
+ *    none
  *
  * Assumptions:
+ *    Called from kernel loop, after the event handlers changed the task
+ *    states accordingly to the received event.
  *
  ****************************************************************************/
 
-int scheduler(kernel_event_t *event);
+void scheduler(void);
 
 
 #endif /* SRC_KERNEL_INCLUDE_SCHEDULER_H_ */
@@ -11,16 +11,31 @@
 #include "config.h"
 #include "kernel.h"
 #include "klib.h"
+#include "task.h"
 
 /****************************************************************************
  * Defined Types.
  ****************************************************************************/
 
 
+/* Highest count a semaphore can reach, further gives are ignored. */
+
+#define SEM_COUNT_MAX   0x7FFF
+
+
+/* Counting Semaphore
+ *
+ * Waiting tasks are kept in FIFO order, linked through task->queue_next,
+ * since a waiting task is never in the ready queue. A given resource is
+ * handed directly to the first waiter, made ready by the give itself,
+ * which does not have to take it again.
+ */
+
 typedef volatile struct
 {
   int resources;                      /* Free resources into the semaphore. */
-  int waiting_task;              /* Queue object for task IDs array. */
+  task_t *wait_head;             /* First waiting task, woken first. */
+  task_t *wait_tail;             /* Last waiting task. */
 } semaphore_t;
 
 
@@ -31,6 +46,7 @@ typedef enum
   SEM_STATUS_SUCCESS,   /* Sem. function returned success. */
   SEM_STATUS_TOOK,      /* Sem. took, resource is free, can continue. */
   SEM_STATUS_BUSY,      /* When using no waiting, this indicates sem. busy. */
+  SEM_STATUS_TIMEOUT,   /* Timed wait expired, the sem. was not took. */
 } SEM_STATUS_T;
 
 
@@ -67,13 +83,34 @@ typedef enum
 void sem_init(semaphore_t *sem);
 
 
+/****************************************************************************
+ * Name: sem_init2
+ *
+ * Description:
+ *  Initialize a counting semaphore having some free resources.
+ *
+ * Input Parameters:
+ *  sem - Pointer to semaphore.
+ *  count - Initial number of free resources, up to SEM_COUNT_MAX.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *
+ ****************************************************************************/
+
+void sem_init2(semaphore_t *sem, int count);
+
+
 /****************************************************************************
  * Name: sem_take
  *
  * Description:
- *  Take the semaphore using a waiting type.
- *  This function does not block, but it will return a specific state for
- *  waiting.
+ *  Take one resource from the semaphore using a waiting type.
+ *  If none is free and waiting was requested, the current task is blocked
+ *  at the end of the wait list, until a resource is handed to it.
  *
  * Input Parameters:
  *  sem - Semaphore pointer.
@@ -81,10 +118,7 @@ void sem_init(semaphore_t *sem);
  *
  * Returned Value:
  *  SEM_STATUS_ERROR - If error encountered.
- *  SEM_STATUS_TOOK - If semaphore was took.
- *  SEM_STATUS_WAIT - If the semaphore is not available.
- *                    The task will not be called after exit, thus until
- *                    semaphore is available.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
  *  SEM_STATUS_BUSY - If the waiting type is WAIT_NO, this is returned when
  *                    the semaphore is not available.
  *
@@ -96,11 +130,38 @@ void sem_init(semaphore_t *sem);
 SEM_STATUS_T sem_take(semaphore_t *sem, SEM_WAIT_T wait);
 
 
+/****************************************************************************
+ * Name: sem_timedtake
+ *
+ * Description:
+ *  Take one resource from the semaphore, waiting at most a number of ticks.
+ *  The task waits both into the wait list of the semaphore and into the
+ *  sleep queue, thus it is woken by whichever comes first.
+ *
+ * Input Parameters:
+ *  sem - Semaphore pointer.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  SEM_STATUS_ERROR - If error encountered.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
+ *  SEM_STATUS_BUSY - If ticks is zero and the semaphore is not available.
+ *  SEM_STATUS_TIMEOUT - If no resource was handed over in time.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+SEM_STATUS_T sem_timedtake(semaphore_t *sem, unsigned int ticks);
+
+
 /****************************************************************************
  * Name: sem_giveISR
  *
  * Description:
- *  Give semaphore from ISR.
+ *  Give semaphore from ISR. The resource is handed to the first waiting
+ *  task, if any, which runs at the next context switch.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -120,7 +181,9 @@ void sem_giveISR(semaphore_t *sem);
  * Name: sem_give
  *
  * Description:
- *  Give semaphore for a resource.
+ *  Give semaphore for a resource. The resource is handed to the first
+ *  waiting task, if any. If it has a higher priority, the current task
+ *  yields to it.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -137,24 +200,25 @@ SEM_STATUS_T sem_give(semaphore_t *sem);
 
 
 /****************************************************************************
- * Name: semaphores
+ * Name: sem_wait_cancel_crit
  *
  * Description:
- *  Process events related to semaphores.
+ *  Remove a task from the wait list of the semaphore it waits on, when its
+ *  timed wait has expired.
  *
  * Input Parameters:
- *  event - Event from kernel.
+ *  task - Task waiting into TASK_STATE_SEM_WAIT.
  *
  * Returned Value:
- *  1 - If there is further work to do by kernel.
- *  0 - If there is no further work to do.
+ *  none
  *
  * Assumptions:
- *  Called from kernel loop only.
+ *  Called from critical section, in kernel context.
+ *  The caller changes the task state.
  *
  ****************************************************************************/
 
-int semaphores(kernel_event_t *event);
+void sem_wait_cancel_crit(task_t *task);
 
 
 #endif /* SEMAPHORE_H_ */
@@ -11,6 +11,90 @@
 #include "config.h"
 
 
+/* Number of task priority levels.
+ * Priority 0 is the highest one. Since the ready bitmap of the scheduler is
+ * one byte wide, at most 8 levels are supported.
+ */
+
+#ifndef CONFIG_TASK_PRIORITIES
+#  define CONFIG_TASK_PRIORITIES        8
+#endif
+
+#if CONFIG_TASK_PRIORITIES < 1 || CONFIG_TASK_PRIORITIES > 8
+#  error "CONFIG_TASK_PRIORITIES must be between 1 and 8."
+#endif
+
+
+/* Priority given to newly created tasks. */
+
+#ifndef CONFIG_TASK_DEFAULT_PRIORITY
+#  define CONFIG_TASK_DEFAULT_PRIORITY  (CONFIG_TASK_PRIORITIES / 2)
+#endif
+
+
+/* Size of the task table, the kernel task included. A task ID holds the
+ * table slot in its low bits and a generation counter above them, thus a
+ * stale ID of a destroyed task does not match the task reusing its slot.
+ */
+
+#ifndef CONFIG_TASK_MAX
+#  define CONFIG_TASK_MAX               8
+#endif
+
+#if CONFIG_TASK_MAX < 2 || CONFIG_TASK_MAX > 32
+#  error "CONFIG_TASK_MAX must be between 2 and 32."
+#elif CONFIG_TASK_MAX <= 8
+#  define TASK_ID_SLOT_BITS             3
+#elif CONFIG_TASK_MAX <= 16
+#  define TASK_ID_SLOT_BITS             4
+#else
+#  define TASK_ID_SLOT_BITS             5
+#endif
+
+#define TASK_ID_SLOT_MASK   ((1 << TASK_ID_SLOT_BITS) - 1)
+
+
+/* Time slice in ticks given to newly created tasks, used when
+ * CONFIG_PREEMPTION is defined. Zero means never preempted.
+ */
+
+#ifndef CONFIG_TASK_DEFAULT_QUANTUM
+#  define CONFIG_TASK_DEFAULT_QUANTUM   1
+#endif
+
+
+/* Stack preparation at task creation. By default the whole stack is
+ * cleared. CONFIG_STACK_PAINT fills it with CONFIG_STACK_PAINT_BYTE instead,
+ * thus the untouched part can be found later. CONFIG_STACK_INIT_LAZY skips
+ * it, only the initial context frame being cleared. The last two options
+ * exclude each other.
+ */
+
+#ifndef CONFIG_STACK_PAINT_BYTE
+#  define CONFIG_STACK_PAINT_BYTE       0xA5
+#endif
+
+#if defined(CONFIG_STACK_PAINT) && defined(CONFIG_STACK_INIT_LAZY)
+#  error "CONFIG_STACK_PAINT and CONFIG_STACK_INIT_LAZY cannot be both defined"
+#endif
+
+
+/* Stack overflow detection. When CONFIG_STACK_CHECK is defined, a canary
+ * word is kept at the bottom of each stack, checked each time the task is
+ * switched out. A task which broke it is never run again and the kernel
+ * event KERNEL_EVENT_STACK_OVERFLOW is raised, having the task as data.
+ * If the event buffer is full, the event is raised later by the kernel.
+ */
+
+#define TASK_STACK_CANARY     0xC35A
+
+#ifdef CONFIG_STACK_CHECK
+#  define TASK_STACK_CANARY_SIZE  sizeof(unsigned int)
+#else
+#  define TASK_STACK_CANARY_SIZE  0
+#endif
+
+
 /* A task can enter into the following states. */
 
 typedef enum
@@ -21,12 +105,22 @@ typedef enum
   TASK_STATE_RUNNING,
   TASK_STATE_IO_WAIT,
   TASK_STATE_SEM_WAIT,
+  TASK_STATE_MUTEX_WAIT,
+  TASK_STATE_FLAGS_WAIT,
+  TASK_STATE_IPC_WAIT,
   TASK_STATE_SLEEP,
   TASK_STATE_PAUSED,
   TASK_STATE_RESUMED,
 } task_state_t;
 
 
+/* Task flags. */
+
+#define TASK_FLAG_SLEEPQ      0x01      /* Task is into the sleep queue. */
+#define TASK_FLAG_TIMEDOUT    0x02      /* Last timed wait has expired. */
+#define TASK_FLAG_OVERFLOW    0x04      /* Stack canary was overwritten. */
+
+
 /*
  * This structure will be stored at the beginning of the stack on each task.
  * Also, known as Task Control Block or TCB.
@@ -34,6 +128,8 @@ typedef enum
  * implicitly to the beginning of the stack address of the task.
  */
 
+struct mutex_s;
+
 typedef struct task
 {
   char name[CONFIG_TASK_MAX_NAME + 1];  /* Task Name String. */
@@ -41,10 +137,22 @@ typedef struct task
   unsigned char *stack_pointer;         /* Saved Stack Pointer. */
   unsigned int stack_size;              /* Configured Stack Size. */
   unsigned int id;                      /* Task ID. */
-  unsigned long wakeup_ticks;           /* Time when the task will be woken. */
+  unsigned int wakeup_delta;            /* Ticks after previous sleeper. */
   task_state_t state;                   /* Task State (sleeping, waiting). */
   task_state_t last_state;              //TODO to be removed?
+  unsigned char priority;               /* Task Priority, 0 is the highest. */
+  unsigned char base_priority;          /* Priority without inheritance. */
+  unsigned char quantum;                /* Time slice length in ticks. */
+  unsigned char slice;                  /* Ticks left from time slice. */
+  unsigned char flags;                  /* Task flags, TASK_FLAG_xxx. */
+  volatile void *wait_obj;              /* Object the task is blocked on. */
+  unsigned int wait_value;              /* Value waited for, or received. */
+  unsigned char wait_opts;              /* Options of the wait. */
+  void *wait_data;                      /* Buffer of a blocked transfer. */
+  volatile struct mutex_s *mutex_held;  /* Last locked mutex still held. */
   struct task *next;                    /* Pointer to next task. */
+  struct task *queue_next;              /* Next task in the ready queue. */
+  struct task *sleep_next;              /* Next task in the sleep queue. */
 } task_t;
 
 
@@ -70,6 +178,32 @@ extern volatile unsigned char *g_stack_pointer;
 extern volatile unsigned char *g_stack_head;
 
 
+/* Lowest address usable by the task area, above the static data. */
+
+extern volatile unsigned char *g_stack_limit;
+
+
+/****************************************************************************
+ * Name: task_init
+ *
+ * Description:
+ *    Empty the task area and subscribe it to the task exit events.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called once from kernel initialization, before the kernel task is
+ *    created.
+ *
+ ****************************************************************************/
+
+void task_init(void);
+
+
 /****************************************************************************
  * Name: task_create
  *
@@ -85,7 +219,7 @@ extern volatile unsigned char *g_stack_head;
  *
  * Returned Value:
  *    1 - For success.
- *    0 - For errors.
+ *    0 - For errors, if the task table is full, or there is no memory left.
  *
  * Assumptions:
  *    Task name and entry point are mandatory.
@@ -96,6 +230,49 @@ int task_create(const char *name, void (*func)(void*),
                 void *arg, int stack_size);
 
 
+/****************************************************************************
+ * Name: task_stack_check_crit
+ *
+ * Description:
+ *    Verify the stack canary of a task which is being switched out. If it
+ *    was overwritten, the task is stopped and the overflow is reported.
+ *
+ * Input Parameters:
+ *    task - Task just switched out.
+ *
+ * Returned Value:
+ *    1 - If the stack is intact.
+ *    0 - If the stack has overflowed.
+ *
+ * Assumptions:
+ *    Called from critical section, when CONFIG_STACK_CHECK is defined.
+ *
+ ****************************************************************************/
+
+int task_stack_check_crit(task_t *task);
+
+
+/****************************************************************************
+ * Name: task_stack_usage
+ *
+ * Description:
+ *    Get the peak stack usage of a task, found from the painted pattern.
+ *
+ * Input Parameters:
+ *    tid - Given task ID. Zero for the current task.
+ *
+ * Returned Value:
+ *    Largest number of stack bytes used so far.
+ *    -1 - For errors, or if CONFIG_STACK_PAINT is not defined.
+ *
+ * Assumptions:
+ *    A function which reserved stack without writing it is not accounted.
+ *
+ ****************************************************************************/
+
+int task_stack_usage(int tid);
+
+
 /****************************************************************************
  * Name: task_getnext
  *
@@ -125,7 +302,7 @@ int task_getnext(task_t **task);
  * Name: task_getby_id
  *
  * Description:
- *    Get a pointer to a task specifying the task id.
+ *    Get a pointer to a task specifying the task id, in constant time.
  *
  * Input Parameters:
  *    tid - Given task ID.
@@ -226,16 +403,21 @@ int task_pause(int tid);
  * Name: task_destroy
  *
  * Description:
- *    Destroy a task specifying the task id.
+ *    Destroy a task specifying the task id, its memory being reused by the
+ *    next created tasks.
  *
  * Input Parameters:
- *    tid - Given task ID.
+ *    tid - Given task ID. Zero for the current task.
  *
  * Returned Value:
  *    1 - For success.
  *    0 - For errors.
+ *    For the current task, it does not return on success.
  *
  * Assumptions:
+ *    A task holding a mutex, or waiting for a mutex, a message queue or a
+ *    mailbox cannot be destroyed.
+ *    The kernel task cannot be destroyed.
  *
  ****************************************************************************/
 
@@ -263,6 +445,52 @@ int task_destroy(int tid);
 int task_sleep(unsigned int tid, const unsigned int ticks);
 
 
+/****************************************************************************
+ * Name: task_setpriority
+ *
+ * Description:
+ *    Change the priority of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    tid - Given task ID.
+ *    priority - New priority, 0 is the highest.
+ *               See, CONFIG_TASK_PRIORITIES.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int task_setpriority(int tid, unsigned char priority);
+
+
+/****************************************************************************
+ * Name: task_setquantum
+ *
+ * Description:
+ *    Change the time slice of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    tid - Given task ID.
+ *    ticks - Number of ticks the task can run before being preempted.
+ *            Zero means the task is never preempted.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    Used only when CONFIG_PREEMPTION is defined. The new value is
+ *    applied the next time the task is run.
+ *
+ ****************************************************************************/
+
+int task_setquantum(int tid, unsigned char ticks);
+
+
 /****************************************************************************
  * Name: task_getid
  *
@@ -8,6 +8,8 @@
 #ifndef SRC_KERNEL_INCLUDE_TIMERS_H_
 #define SRC_KERNEL_INCLUDE_TIMERS_H_
 
+#include "task.h"
+
 
 void reset_watchdog(void);
 void start_systick(void);
@@ -15,8 +17,17 @@ void start_watchdog(void);
 void configure_systick(void);
 void configure_watchdog(void);
 void systick(void);
+void systick_add(unsigned int ticks);
 unsigned long getsysticks(void);
 
+/* Sleep queue, sorted by wake-up time. See, timers.c */
+void sleepq_init(void);
+void sleepq_insert(task_t *task, unsigned int ticks);
+void sleepq_insert_crit(task_t *task, unsigned int ticks);
+void sleepq_remove_crit(task_t *task);
+unsigned int sleepq_next_ticks(void);
+int sleepq_expire(void);
+
 extern volatile unsigned long g_systicks;
 
 #endif /* SRC_KERNEL_INCLUDE_TIMERS_H_ */
@@ -21,6 +21,7 @@
 #include "semaphore.h"
 #include "klib.h"
 #include "context.h"
+#include "kernel_api.h"
 
 
 /****************************************************************************
@@ -32,19 +33,58 @@
  * Events produced by INTERRUPTS, KERNEL are stored temporarily in this buffer
  * and consumed from here by kernel itself, its submodules and finally tasks.
  *
- * Two indexes are used, one for inserting events -write_idx- and one for
- * retrieve events -read_idx- respectively.
+ * Free running indexes are used, one for inserting events -write_idx-
+ * written only by producers, and two written only by the kernel: one for
+ * retrieving events -read_idx- and one for releasing their slots after
+ * they were consumed in place -free_idx-. The capacity is a power of two,
+ * thus the indexes are wrapped by masking and their differences are the
+ * used sizes. Being one byte long, each index is read and written
+ * atomically, so the kernel consumes events without disabling interrupts.
  */
 
+#if CONFIG_MAX_EVENTS < 2 || CONFIG_MAX_EVENTS > 128 || \
+    (CONFIG_MAX_EVENTS & (CONFIG_MAX_EVENTS - 1))
+#  error "CONFIG_MAX_EVENTS must be a power of two, between 2 and 128."
+#endif
+
+#define KEVENT_MASK   (CONFIG_MAX_EVENTS - 1)
+
 static volatile struct
 {
   unsigned char read_idx;                   /* Position for retrieving. */
+  unsigned char free_idx;                   /* Position for releasing. */
   unsigned char write_idx;                  /* Position for inserting. */
-  unsigned char used_size;                  /* Events stored in array. */
   kernel_event_t event[CONFIG_MAX_EVENTS];  /* Events are stored here. */
 } g_kevent_buffer;
 
 
+/* Coalesced Events
+ *
+ * Bit N is set while an event of type N, inserted by kput_event_once_crit(),
+ * is waiting into the buffer. It is cleared by the kernel just before the
+ * event is consumed, thus later events of the same type are inserted again.
+ */
+
+static volatile unsigned int g_kevent_queued;
+
+
+/* Bit N is set when an event of type N, inserted by kput_event_once_crit(),
+ * found the buffer full. It is inserted again by the kernel as soon as a
+ * slot is released, thus a coalesced event is never lost.
+ */
+
+static volatile unsigned int g_kevent_lost;
+
+
+/* Event Dispatch Table
+ *
+ * One list of handlers per event type, filled by kernel_subscribe().
+ * An event is given only to the modules subscribed to its type.
+ */
+
+static kevent_handler_t *g_kevent_handlers[KERNEL_EVENT_TYPES];
+
+
 /****************************************************************************
  * Private functions.
  ****************************************************************************/
@@ -54,65 +94,79 @@ static volatile struct
  * Name: kget_event
  *
  * Description:
- *    Retrieve next event available in the circular buffer.
+ *    Get the next event available in the circular buffer, in place.
  *
- * Output Parameters:
- *    event - Retrieved event from buffer.
+ * Input Parameters:
+ *    none
  *
  * Returned Value:
- *    1 - if the event is valid.
- *    0 - if the event is invalid.
+ *    Pointer to the event slot - if there is an event available.
+ *    NULL - if the buffer is empty.
  *
  * Assumptions:
  *    This should be called only from kernel context.
+ *    The slot is owned by kernel till kfree_event() is called.
  *
  ****************************************************************************/
 
-static int kget_event(kernel_event_t *event)
+static kernel_event_t *kget_event(void)
 {
-  int ret = 0;
+  unsigned char read_idx = g_kevent_buffer.read_idx;
 
-  if (event == NULL)
+  if (read_idx == g_kevent_buffer.write_idx)
     {
-      return ret;
+      return NULL;
     }
 
-  /* Enter critical and check for available event. */
+  g_kevent_buffer.read_idx = read_idx + 1;
+  return &g_kevent_buffer.event[read_idx & KEVENT_MASK];
+}
 
-  disable_interrupts();
-  if (g_kevent_buffer.used_size > 0)
-    {
-      /* Copy event from kernel buffer in order to be used locally. */
 
-      kmemcpy((void*) event,
-              (void*) &g_kevent_buffer.event[g_kevent_buffer.read_idx],
-              sizeof(kernel_event_t));
+/****************************************************************************
+ * Name: kfree_event
+ *
+ * Description:
+ *    Release the slot of the event returned by kget_event(), making it
+ *    available to producers. The coalesced events lost meanwhile are
+ *    inserted again.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    This should be called only from kernel context, after the event
+ *    was consumed.
+ *
+ ****************************************************************************/
 
-      /* Decrease used slots in buffer.
-       *
-       * NOTE: The event content is not removed from buffer.
-       * FIXME: Not sure if removing its content is really required.
-       */
+static void kfree_event(void)
+{
+  unsigned char type;
+  unsigned int flag;
 
-      g_kevent_buffer.used_size--;
-      g_kevent_buffer.read_idx++;
+  g_kevent_buffer.free_idx++;
 
-      /* Buffer overlapping.
-       * TODO: Use modulo % if is more efficient.
-       */
+  if (!g_kevent_lost)
+    {
+      return;
+    }
 
-      if (g_kevent_buffer.read_idx >= CONFIG_MAX_EVENTS)
+  /* Insert again the coalesced events which found the buffer full. */
+
+  disable_interrupts();
+  for (type = 0, flag = 1; g_kevent_lost && flag; type++, flag <<= 1)
+    {
+      if ((g_kevent_lost & flag) && kput_event_crit(type, NULL))
         {
-            g_kevent_buffer.read_idx = 0;
+          g_kevent_lost &= ~flag;
+          g_kevent_queued |= flag;
         }
-
-      ret = 1;
     }
-
-  /* Exit critical section. */
-
   enable_interrupts();
-  return ret;
 }
 
 
@@ -120,9 +174,10 @@ static int kget_event(kernel_event_t *event)
  * Name: kconsume_event
  *
  * Description:
- *  - Dispatch the event to all system modules, tasks in order to be consumed.
- *  - This function is most cpu intensive and time consuming since it has to
- *    go through all possible finite states of all modules including tasks.
+ *  - Dispatch the event to the handlers subscribed to its type, in order
+ *    of subscription, then run the ready tasks.
+ *  - This function is most cpu intensive and time consuming since tasks
+ *    are run from here.
  *  - Also, expected to return before SysTick to tick.
  *
  * Input Parameters:
@@ -137,24 +192,32 @@ static int kget_event(kernel_event_t *event)
 
 static void kconsume_event(kernel_event_t *event)
 {
-  int work_todo;
+  kevent_handler_t *node;
+  unsigned char type = event->type;
+  unsigned int flag = 1 << type;
 
-  /* Finish all possible work for this event. */
+  /* Allow a new coalesced event of this type to be inserted, from now on. */
 
-  do
+  if (g_kevent_queued & flag)
     {
-      work_todo = 0;
+      disable_interrupts();
+      g_kevent_queued &= ~flag;
+      enable_interrupts();
+    }
 
-      /* Add other kernel submodules here (io, sem, etc.). */
+  /* Let the subscribed modules change the task states. */
 
-      work_todo |= semaphores(event);
-      work_todo |= scheduler(event);
+  if (type < KERNEL_EVENT_TYPES)
+    {
+      for (node = g_kevent_handlers[type]; node; node = node->next)
+        {
+          node->handler(event);
+        }
     }
-  while (work_todo);
 
-  /* Clear event. */
+  /* Finish all possible work, running the ready tasks. */
 
-  kmemset((void*) event, 0, sizeof(kernel_event_t));
+  scheduler();
 }
 
 
@@ -177,7 +240,7 @@ static void kconsume_event(kernel_event_t *event)
 
 static void kernel_event_loop(void)
 {
-  kernel_event_t event;
+  kernel_event_t *event;
 
   /* Forever processing events. */
 
@@ -185,7 +248,7 @@ static void kernel_event_loop(void)
     {
       /* Consume all events from buffer. */
 
-      while (kget_event(&event))
+      while ((event = kget_event()))
         {
           /* Now, events are going to be consumed by other system parts,
            * (io modules, semaphores, timers, scheduler, tasks, etc).
@@ -194,7 +257,11 @@ static void kernel_event_loop(void)
            * Expected to return before SysTick timer to tick.
            */
 
-          kconsume_event(&event);
+          kconsume_event(event);
+
+          /* Release the event slot back to producers. */
+
+          kfree_event();
 
           /* Here, all events in the queue were consumed.
            * It is time to reset the watch dog timer.
@@ -203,12 +270,16 @@ static void kernel_event_loop(void)
           reset_watchdog();
         }
 
+      /* Run the tasks made ready directly by ISR, without any event. */
+
+      scheduler();
+
       /* Kernel reach here only after all the work was done
        * (drivers, semaphores, ipc, scheduler, tasks, etc)
        * and have nothing else to do.
        *
-       * FIXME: An interrupt can sneak here leaving it un-consumed,
-       * but it is saved into event queue and consumed next tick.
+       * An interrupt sneaking here is not missed, go_idle() returns at
+       * once if it produced an event or made a task ready.
        */
 
       go_idle();
@@ -239,33 +310,78 @@ static void kernel_event_loop(void)
  *           pointer. (char, int, void*).
  *
  * Returned Value:
- *    none
+ *    1 - If the event was inserted.
+ *    0 - If the buffer is full and the event was dropped.
  *
  * Assumptions:
  *    This should be called only from critical section or ISR context.
  *
  ****************************************************************************/
 
-void kput_event_crit(unsigned char type, void * data)
+int kput_event_crit(unsigned char type, void * data)
 {
-  if (g_kevent_buffer.used_size >= CONFIG_MAX_EVENTS)
+  unsigned char write_idx = g_kevent_buffer.write_idx;
+  kernel_event_t *event;
+
+  /* Check if the buffer is full. */
+
+  if ((unsigned char) (write_idx - g_kevent_buffer.free_idx) >=
+      CONFIG_MAX_EVENTS)
     {
-      return;
+      return 0;
     }
 
-  g_kevent_buffer.event[g_kevent_buffer.write_idx].type = type;
-  g_kevent_buffer.event[g_kevent_buffer.write_idx].data = data;
-  g_kevent_buffer.used_size++;
-  g_kevent_buffer.write_idx++;
+  /* Fill the slot first, then publish it to the kernel. */
 
-  /* Buffer overlapping.
-   * TODO: Use modulo % if is more efficient.
-   */
+  event = &g_kevent_buffer.event[write_idx & KEVENT_MASK];
+  event->type = type;
+  event->data = data;
+
+  g_kevent_buffer.write_idx = write_idx + 1;
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: kput_event_once_crit
+ *
+ * Description:
+ *    Insert new event in the circular buffer, only if no other event of
+ *    the same type is waiting to be consumed. Used for idempotent events
+ *    without data, thus a burst of them is coalesced into one event.
+ *    If the buffer is full, the event is inserted by the kernel as soon
+ *    as a slot is released, thus it is never lost.
+ *
+ * Input Parameters:
+ *    type - Event type, lower than 16.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    This should be called only from critical section or ISR context.
+ *
+ ****************************************************************************/
+
+void kput_event_once_crit(unsigned char type)
+{
+  unsigned int flag = 1 << type;
+
+  if (g_kevent_queued & flag)
+    {
+      return;
+    }
 
-  if (g_kevent_buffer.write_idx >= CONFIG_MAX_EVENTS)
+  if (kput_event_crit(type, NULL))
     {
-      g_kevent_buffer.write_idx = 0;
+      g_kevent_queued |= flag;
+      g_kevent_lost &= ~flag;
+      return;
     }
+
+  /* The buffer is full, let the kernel insert it later. */
+
+  g_kevent_lost |= flag;
 }
 
 
@@ -297,6 +413,80 @@ void kput_event(unsigned char type, void * data)
 }
 
 
+/****************************************************************************
+ * Name: kernel_subscribe
+ *
+ * Description:
+ *    Register a handler for an event type. The handlers of a type are
+ *    called in order of subscription, for every event of that type, just
+ *    before the scheduler runs the ready tasks.
+ *
+ * Input Parameters:
+ *    type - Event type.
+ *    node - Handler node, having the handler function set.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    Called from kernel initialization or from kernel context.
+ *    The node must remain valid while subscribed, and it can be subscribed
+ *    to a single event type.
+ *
+ ****************************************************************************/
+
+int kernel_subscribe(unsigned char type, kevent_handler_t *node)
+{
+  kevent_handler_t **link;
+
+  if (type >= KERNEL_EVENT_TYPES || !node || !node->handler)
+    {
+      return 0;
+    }
+
+  /* Append it, keeping the order of subscription. */
+
+  for (link = &g_kevent_handlers[type]; *link; link = &(*link)->next)
+    {
+      if (*link == node)
+        {
+          return 1;
+        }
+    }
+
+  node->next = NULL;
+  *link = node;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: kevent_pending
+ *
+ * Description:
+ *    Check if there are events waiting in the circular buffer.
+ *    The event being consumed by kernel is not counted.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    1 - If at least one event is waiting to be consumed.
+ *    0 - If the buffer is empty.
+ *
+ * Assumptions:
+ *    The indexes are one byte long, thus they are read atomically.
+ *
+ ****************************************************************************/
+
+int kevent_pending(void)
+{
+  return g_kevent_buffer.read_idx != g_kevent_buffer.write_idx;
+}
+
+
 /****************************************************************************
  * Name: kernel_init
  *
@@ -320,12 +510,24 @@ void kernel_init(void)
 
   g_systicks        = 0;
   g_stack_head      = NULL;
+  g_stack_limit     = NULL;
   g_task_list_head  = NULL;
   g_running_task    = NULL;
 
   /* Clear buffers. */
 
   kmemset((void*) &g_kevent_buffer, 0, sizeof(g_kevent_buffer));
+  kmemset((void*) g_kevent_handlers, 0, sizeof(g_kevent_handlers));
+  g_kevent_queued = 0;
+  g_kevent_lost = 0;
+
+  /* Empty the ready queue of the scheduler, the sleep queue and the task
+   * area, also subscribe the kernel modules to their events.
+   */
+
+  scheduler_init();
+  sleepq_init();
+  task_init();
 
   /* Configure timers. */
 
@@ -335,6 +537,7 @@ void kernel_init(void)
   /* Read architecture specific stack properties. */
 
   stack_init((void**) &g_stack_head);
+  stack_limit((void**) &g_stack_limit);
 
   /* Create kernel task. */
 
@@ -6,6 +6,7 @@
  */
 
 #include "klib.h"
+#include "cpu.h"
 
 
 /****************************************************************************
@@ -208,8 +209,8 @@ int kstreq(const char *str1, const char *str2)
  * Parameters:
  *    queue - Pointer to queue object.
  *    array - Pointer to storage array.
- *    array_size - The size of storage array.
- *    element_size - The size of one element in array.
+ *    array_size - The size of storage array, in elements.
+ *    element_size - The size of one element in array, in bytes.
  *
  * Returned Value:
  *    1 - For success.
@@ -250,8 +251,8 @@ int kqueue_init
  * Parameters:
  *    queue - Pointer to queue object.
  *    array - Pointer to storage array.
- *    array_size - The size of storage array.
- *    element_size - The size of one element in array.
+ *    array_size - The size of storage array, in elements.
+ *    element_size - The size of one element in array, in bytes.
  *    used_size - The count of already used elements.
  *
  * Returned Value:
@@ -330,12 +331,13 @@ int kenqueue(queue_t *queue, void *indata)
   queue->used_size++;
 
   /* Check for array boundary and reset the pointer to the beginning
-   * of the array.
+   * of the array. The array size is counted in elements.
    *
    * TODO: Verify if modulo % operator is more efficient here.
    */
 
-  if (queue->write_ptr >= (queue->array_ptr + queue->array_size))
+  if (queue->write_ptr >=
+      (queue->array_ptr + queue->array_size * queue->element_size))
     {
       queue->write_ptr = queue->array_ptr;
     }
@@ -391,12 +393,13 @@ int kdequeue(queue_t *queue, void *outdata)
       queue->used_size--;
 
       /* Check for array boundary and reset the pointer to the beginning
-       * of the array.
+       * of the array. The array size is counted in elements.
        *
        * TODO: Verify if modulo % operator is more efficient here.
        */
 
-      if (queue->read_ptr >= (queue->array_ptr + queue->array_size))
+      if (queue->read_ptr >=
+          (queue->array_ptr + queue->array_size * queue->element_size))
         {
           queue->read_ptr = queue->array_ptr;
         }
@@ -498,3 +501,266 @@ void kqueue_destroy(queue_t *queue)
       queue->used_size    = 0;
     }
 }
+
+
+/****************************************************************************
+ * Name: kpool_init
+ *
+ * Description:
+ *    Pool initialization, all blocks being free.
+ *    The array is split into block_count blocks of block_size bytes.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    array - Pointer to storage array, of block_count * block_size bytes.
+ *    block_count - Number of blocks.
+ *    block_size - The size of one block, in bytes, at least a pointer.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_init(kpool_t *pool, void *array, int block_count, int block_size)
+{
+  unsigned char *block;
+  int i;
+
+  if (!pool || !array || block_count <= 0 ||
+      block_size < (int) sizeof(void*))
+    {
+      return 0;
+    }
+
+  /* Link every block to the next one, the last one ends the list. */
+
+  block = (unsigned char*) array;
+  for (i = 0; i < block_count - 1; i++)
+    {
+      *(void**) block = block + block_size;
+      block += block_size;
+    }
+
+  *(void**) block = NULL;
+
+  pool->array_ptr  = array;
+  pool->array_end  = block + block_size;
+  pool->free_head  = array;
+  pool->block_size = block_size;
+  pool->used_count = 0;
+  pool->max_used   = 0;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: kpool_alloc_crit
+ *
+ * Description:
+ *    Take one block out of the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc_crit(kpool_t *pool)
+{
+  void *block;
+
+  if (!pool || !pool->free_head)
+    {
+      return NULL;
+    }
+
+  block = pool->free_head;
+  pool->free_head = *(void**) block;
+
+  if (++pool->used_count > pool->max_used)
+    {
+      pool->max_used = pool->used_count;
+    }
+
+  return block;
+}
+
+
+/****************************************************************************
+ * Name: kpool_alloc
+ *
+ * Description:
+ *    Take one block out of the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Pointer to block.
+ *    NULL - If the pool is exhausted or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+void *kpool_alloc(kpool_t *pool)
+{
+  void *block;
+
+  disable_interrupts();
+  block = kpool_alloc_crit(pool);
+  enable_interrupts();
+
+  return block;
+}
+
+
+/****************************************************************************
+ * Name: kpool_free_crit
+ *
+ * Description:
+ *    Give one block back to the pool, without locking.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+int kpool_free_crit(kpool_t *pool, void *block)
+{
+  /* Only a range check, the alignment check would need a division. */
+
+  if (!pool || !block || !pool->used_count ||
+      block < pool->array_ptr || block >= pool->array_end)
+    {
+      return 0;
+    }
+
+  *(void**) block = pool->free_head;
+  pool->free_head = block;
+  pool->used_count--;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: kpool_free
+ *
+ * Description:
+ *    Give one block back to the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *    block - Pointer to block, as returned by kpool_alloc().
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the block is not part of the pool or error.
+ *
+ * Assumptions:
+ *    Called from task context, interrupts are disabled meanwhile.
+ *
+ ****************************************************************************/
+
+int kpool_free(kpool_t *pool, void *block)
+{
+  int ret;
+
+  disable_interrupts();
+  ret = kpool_free_crit(pool, block);
+  enable_interrupts();
+
+  return ret;
+}
+
+
+/****************************************************************************
+ * Name: kpool_get_usedcount
+ *
+ * Description:
+ *    Get the number of allocated blocks.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_usedcount(kpool_t *pool)
+{
+  int count;
+
+  if (!pool)
+    {
+      return -1;
+    }
+
+  disable_interrupts();
+  count = pool->used_count;
+  enable_interrupts();
+
+  return count;
+}
+
+
+/****************************************************************************
+ * Name: kpool_get_maxused
+ *
+ * Description:
+ *    Get the high-water mark, the largest number of blocks ever allocated
+ *    at the same time. Used to size the pool.
+ *
+ * Parameters:
+ *    pool - Pointer to pool object.
+ *
+ * Returned Value:
+ *    Largest number of allocated blocks.
+ *    -1 - If error.
+ *
+ * Assumptions:
+ *    none
+ *
+ ****************************************************************************/
+
+int kpool_get_maxused(kpool_t *pool)
+{
+  int count;
+
+  if (!pool)
+    {
+      return -1;
+    }
+
+  disable_interrupts();
+  count = pool->max_used;
+  enable_interrupts();
+
+  return count;
+}
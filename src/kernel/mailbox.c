@@ -0,0 +1,471 @@
+/*
+ * mailbox.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "config.h"
+#include "cpu.h"
+#include "kernel.h"
+#include "kernel_api.h"
+#include "task.h"
+#include "scheduler.h"
+#include "mailbox.h"
+#include "context.h"
+
+
+/****************************************************************************
+ * Private functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mbox_wait_crit
+ *
+ * Description:
+ *  Append the current task to a wait list of the mailbox.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  head - Wait list, receivers or senders.
+ *  task - Current task.
+ *  msg - Buffer to be posted, NULL for receivers.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void mbox_wait_crit(mailbox_t *mbox, task_t **head, task_t *task,
+                           void *msg)
+{
+  sched_wait_append_crit(head, task);
+
+  task->wait_obj = mbox;
+  task->wait_data = msg;
+  task->state = TASK_STATE_IPC_WAIT;
+}
+
+
+/****************************************************************************
+ * Name: mbox_wake_crit
+ *
+ * Description:
+ *  Remove the first task from a wait list and make it ready.
+ *
+ * Input Parameters:
+ *  head - Wait list, receivers or senders.
+ *
+ * Returned Value:
+ *  Pointer to the woken task.
+ *
+ * Assumptions:
+ *  Called from critical section or ISR. The list is not empty.
+ *
+ ****************************************************************************/
+
+static task_t *mbox_wake_crit(task_t **head)
+{
+  task_t *task = *head;
+
+  *head = task->queue_next;
+
+  task->queue_next = NULL;
+  task->wait_obj = NULL;
+  task->state = TASK_STATE_READY;
+  sched_ready_insert(task);
+
+  return task;
+}
+
+
+/****************************************************************************
+ * Name: mbox_post_crit
+ *
+ * Description:
+ *  Pass a buffer without waiting. A waiting receiver gets it directly,
+ *  otherwise it is stored into a free slot.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer.
+ *  woken - Set to the woken receiver, if any.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full.
+ *
+ * Assumptions:
+ *  Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+static int mbox_post_crit(mailbox_t *mbox, void *msg, task_t **woken)
+{
+  unsigned int idx;
+
+  /* Receivers are waiting only while the mailbox is empty. */
+
+  if (mbox->recv_head)
+    {
+      mbox->recv_head->wait_data = msg;
+      *woken = mbox_wake_crit((task_t**) &mbox->recv_head);
+      return 1;
+    }
+
+  if (mbox->used >= mbox->size)
+    {
+      return 0;
+    }
+
+  idx = mbox->read_idx + mbox->used;
+  if (idx >= mbox->size)
+    {
+      idx -= mbox->size;
+    }
+
+  mbox->slots[idx] = msg;
+  mbox->used++;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: mbox_fetch_crit
+ *
+ * Description:
+ *  Take the oldest buffer without waiting. The freed slot is filled with
+ *  the buffer of the first waiting sender, which is woken.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  woken - Set to the woken sender, if any.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - If the mailbox is empty.
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void *mbox_fetch_crit(mailbox_t *mbox, task_t **woken)
+{
+  void *msg;
+  unsigned int idx;
+
+  if (!mbox->used)
+    {
+      return NULL;
+    }
+
+  msg = mbox->slots[mbox->read_idx];
+
+  /* Senders are waiting only while the mailbox is full, thus the freed
+   * slot is the one following the newest pointer.
+   */
+
+  if (mbox->send_head)
+    {
+      mbox->slots[mbox->read_idx] = mbox->send_head->wait_data;
+      *woken = mbox_wake_crit((task_t**) &mbox->send_head);
+    }
+  else
+    {
+      mbox->used--;
+    }
+
+  idx = mbox->read_idx + 1;
+  mbox->read_idx = idx >= mbox->size ? 0 : idx;
+
+  return msg;
+}
+
+
+/****************************************************************************
+ * Name: mbox_post_common
+ *
+ * Description:
+ *  Pass a buffer, optionally waiting while the mailbox is full.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer.
+ *  wait - Zero for no waiting at all.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+static int mbox_post_common(mailbox_t *mbox, void *msg, int wait)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *woken = NULL;
+  int ret;
+
+  if (!mbox || !msg || !task)
+    {
+      return 0;
+    }
+
+  disable_interrupts();
+  ret = mbox_post_crit(mbox, msg, &woken);
+
+  if (!ret && wait)
+    {
+      /* The first receiver which frees a slot stores the buffer. */
+
+      mbox_wait_crit(mbox, (task_t**) &mbox->send_head, task, msg);
+      enable_interrupts();
+
+      context_switch_to_kernel();
+      return 1;
+    }
+
+  enable_interrupts();
+
+  sched_yield_if_higher(woken);
+  return ret;
+}
+
+
+/****************************************************************************
+ * Name: mbox_fetch_common
+ *
+ * Description:
+ *  Take the oldest buffer, optionally waiting while the mailbox is empty.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  wait - Zero for no waiting at all.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - If the mailbox is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+static void *mbox_fetch_common(mailbox_t *mbox, int wait)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *woken = NULL;
+  void *msg;
+
+  if (!mbox || !task)
+    {
+      return NULL;
+    }
+
+  disable_interrupts();
+  msg = mbox_fetch_crit(mbox, &woken);
+
+  if (!msg && wait)
+    {
+      /* The first sender puts its buffer into task->wait_data. */
+
+      mbox_wait_crit(mbox, (task_t**) &mbox->recv_head, task, NULL);
+      enable_interrupts();
+
+      context_switch_to_kernel();
+      return task->wait_data;
+    }
+
+  enable_interrupts();
+
+  sched_yield_if_higher(woken);
+  return msg;
+}
+
+
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mbox_init
+ *
+ * Description:
+ *  Initialize an empty mailbox.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  slots - Array of pointers, used as storage.
+ *  size - Number of slots, between 1 and 255.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int mbox_init(mailbox_t *mbox, void **slots, unsigned char size)
+{
+  if (!mbox || !slots || !size)
+    {
+      return 0;
+    }
+
+  mbox->slots = slots;
+  mbox->size = size;
+  mbox->read_idx = 0;
+  mbox->used = 0;
+  mbox->recv_head = NULL;
+  mbox->send_head = NULL;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: mbox_post
+ *
+ * Description:
+ *  Pass a buffer to the receiver, blocking the current task while the
+ *  mailbox is full. The buffer must not be used after posting it.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_post(mailbox_t *mbox, void *msg)
+{
+  return mbox_post_common(mbox, msg, 1);
+}
+
+
+/****************************************************************************
+ * Name: mbox_trypost
+ *
+ * Description:
+ *  Pass a buffer to the receiver only if there is room, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int mbox_trypost(mailbox_t *mbox, void *msg)
+{
+  return mbox_post_common(mbox, msg, 0);
+}
+
+
+/****************************************************************************
+ * Name: mbox_postISR
+ *
+ * Description:
+ *  Pass a buffer to the receiver from ISR, without waiting. A waiting
+ *  receiver gets it directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *  msg - Pointer to buffer, not NULL.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the mailbox is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int mbox_postISR(mailbox_t *mbox, void *msg)
+{
+  task_t *woken = NULL;
+
+  if (!mbox || !msg)
+    {
+      return 0;
+    }
+
+  return mbox_post_crit(mbox, msg, &woken);
+}
+
+
+/****************************************************************************
+ * Name: mbox_fetch
+ *
+ * Description:
+ *  Take the oldest buffer, blocking the current task while the mailbox is
+ *  empty. The receiver becomes the owner of the buffer.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_fetch(mailbox_t *mbox)
+{
+  return mbox_fetch_common(mbox, 1);
+}
+
+
+/****************************************************************************
+ * Name: mbox_tryfetch
+ *
+ * Description:
+ *  Take the oldest buffer only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  mbox - Pointer to mailbox.
+ *
+ * Returned Value:
+ *  Pointer to buffer.
+ *  NULL - If the mailbox is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+void *mbox_tryfetch(mailbox_t *mbox)
+{
+  return mbox_fetch_common(mbox, 0);
+}
@@ -0,0 +1,551 @@
+/*
+ * msgq.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "config.h"
+#include "cpu.h"
+#include "klib.h"
+#include "kernel.h"
+#include "kernel_api.h"
+#include "task.h"
+#include "scheduler.h"
+#include "msgq.h"
+#include "context.h"
+
+
+/****************************************************************************
+ * Private functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: msgq_wait_crit
+ *
+ * Description:
+ *  Append the current task to a wait list of the message queue, keeping
+ *  its pending transfer into the task itself.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  head - Wait list, receivers or senders.
+ *  task - Current task.
+ *  data - Buffer of the transfer, not yet done.
+ *  count - Number of messages of the transfer, not yet done.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void msgq_wait_crit(msgq_t *msgq, task_t **head, task_t *task,
+                           void *data, int count)
+{
+  sched_wait_append_crit(head, task);
+
+  task->wait_obj = msgq;
+  task->wait_data = data;
+  task->wait_value = count;
+  task->state = TASK_STATE_IPC_WAIT;
+}
+
+
+/****************************************************************************
+ * Name: msgq_wake_crit
+ *
+ * Description:
+ *  Remove the first task from a wait list and make it ready.
+ *
+ * Input Parameters:
+ *  head - Wait list, receivers or senders.
+ *  woken - Keeps the highest priority woken task.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+static void msgq_wake_crit(task_t **head, task_t **woken)
+{
+  task_t *task = *head;
+
+  *head = task->queue_next;
+
+  task->queue_next = NULL;
+  task->wait_obj = NULL;
+  task->state = TASK_STATE_READY;
+  sched_ready_insert(task);
+
+  if (!*woken || task->priority < (*woken)->priority)
+    {
+      *woken = task;
+    }
+}
+
+
+/****************************************************************************
+ * Name: msgq_send_crit
+ *
+ * Description:
+ *  Send one message, without waiting. While the queue is empty, the
+ *  message is copied directly into the buffer of the first waiting
+ *  receiver, which is woken. Otherwise it is stored into the queue.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be sent.
+ *  woken - Keeps the highest priority woken task.
+ *
+ * Returned Value:
+ *  1 - If the message was sent.
+ *  0 - If the queue is full.
+ *
+ * Assumptions:
+ *  Called from critical section or ISR.
+ *
+ ****************************************************************************/
+
+static int msgq_send_crit(msgq_t *msgq, const void *msg, task_t **woken)
+{
+  queue_t *queue = (queue_t*) &msgq->queue;
+  task_t *task;
+
+  /* Receivers are waiting only while the queue is empty. */
+
+  if ((task = msgq->recv_head))
+    {
+      kmemcpy(task->wait_data, (void*) msg, queue->element_size);
+      task->wait_value = 1;
+
+      msgq_wake_crit((task_t**) &msgq->recv_head, woken);
+      return 1;
+    }
+
+  return kenqueue(queue, (void*) msg);
+}
+
+
+/****************************************************************************
+ * Name: msgq_recv_crit
+ *
+ * Description:
+ *  Receive one message, without waiting. The freed slot is filled with the
+ *  next pending message of the first waiting sender, which is woken once
+ *  all its messages are stored.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *  woken - Keeps the highest priority woken task.
+ *
+ * Returned Value:
+ *  1 - If a message was received.
+ *  0 - If the queue is empty.
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static int msgq_recv_crit(msgq_t *msgq, void *msg, task_t **woken)
+{
+  queue_t *queue = (queue_t*) &msgq->queue;
+  task_t *task;
+
+  if (!kdequeue(queue, msg))
+    {
+      return 0;
+    }
+
+  /* Senders are waiting only while the queue is full. */
+
+  if ((task = msgq->send_head))
+    {
+      kenqueue(queue, task->wait_data);
+      task->wait_data = (unsigned char*) task->wait_data +
+                        queue->element_size;
+
+      if (!--task->wait_value)
+        {
+          msgq_wake_crit((task_t**) &msgq->send_head, woken);
+        }
+    }
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: msgq_send_common
+ *
+ * Description:
+ *  Send messages, optionally waiting until all of them are sent.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Array of messages.
+ *  count - Number of messages.
+ *  wait - Zero for no waiting at all.
+ *
+ * Returned Value:
+ *  Number of sent messages.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+static int msgq_send_common(msgq_t *msgq, const void *msgs, int count,
+                            int wait)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *woken = NULL;
+  const unsigned char *msg = msgs;
+  int sent;
+
+  if (!msgq || !msgs || count <= 0 || !task)
+    {
+      return 0;
+    }
+
+  /* One message is copied per critical section, thus the interrupt
+   * latency does not grow with the number of messages.
+   */
+
+  for (sent = 0; sent < count; sent++, msg += msgq->queue.element_size)
+    {
+      disable_interrupts();
+      if (!msgq_send_crit(msgq, msg, &woken))
+        {
+          break;
+        }
+      enable_interrupts();
+    }
+
+  if (sent < count)
+    {
+      if (wait)
+        {
+          /* The receivers store the remaining messages, as they make
+           * room.
+           */
+
+          msgq_wait_crit(msgq, (task_t**) &msgq->send_head, task,
+                         (void*) msg, count - sent);
+          enable_interrupts();
+
+          context_switch_to_kernel();
+          return count;
+        }
+
+      enable_interrupts();
+    }
+
+  sched_yield_if_higher(woken);
+  return sent;
+}
+
+
+/****************************************************************************
+ * Name: msgq_recv_common
+ *
+ * Description:
+ *  Receive messages, optionally waiting while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Buffer for count messages.
+ *  count - Maximum number of messages.
+ *  wait - Zero for no waiting at all.
+ *
+ * Returned Value:
+ *  Number of received messages.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+static int msgq_recv_common(msgq_t *msgq, void *msgs, int count, int wait)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *woken = NULL;
+  unsigned char *msg = msgs;
+  int got;
+
+  if (!msgq || !msgs || count <= 0 || !task)
+    {
+      return 0;
+    }
+
+  /* One message is copied per critical section. */
+
+  for (got = 0; got < count; got++, msg += msgq->queue.element_size)
+    {
+      disable_interrupts();
+      if (!msgq_recv_crit(msgq, msg, &woken))
+        {
+          break;
+        }
+      enable_interrupts();
+    }
+
+  if (got < count)
+    {
+      if (!got && wait)
+        {
+          /* The first sender copies its message directly into msgs. */
+
+          msgq_wait_crit(msgq, (task_t**) &msgq->recv_head, task, msgs,
+                         count);
+          enable_interrupts();
+
+          context_switch_to_kernel();
+          return task->wait_value;
+        }
+
+      enable_interrupts();
+    }
+
+  sched_yield_if_higher(woken);
+  return got;
+}
+
+
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: msgq_init
+ *
+ * Description:
+ *  Initialize an empty message queue.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  array - Storage array, having count * size bytes.
+ *  count - Number of messages which can be stored.
+ *  size - Size of one message in bytes.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+int msgq_init(msgq_t *msgq, void *array, int count, int size)
+{
+  if (!msgq)
+    {
+      return 0;
+    }
+
+  msgq->recv_head = NULL;
+  msgq->send_head = NULL;
+
+  return kqueue_init((queue_t*) &msgq->queue, array, count, size);
+}
+
+
+/****************************************************************************
+ * Name: msgq_send
+ *
+ * Description:
+ *  Send one message, blocking the current task while the queue is full.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_send(msgq_t *msgq, const void *msg)
+{
+  return msgq_send_common(msgq, msg, 1, 1);
+}
+
+
+/****************************************************************************
+ * Name: msgq_sendn
+ *
+ * Description:
+ *  Send many messages in one step, blocking the current task while the
+ *  queue is full, until all of them are sent.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Array of messages to be copied.
+ *  count - Number of messages.
+ *
+ * Returned Value:
+ *  Number of sent messages, which is count.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_sendn(msgq_t *msgq, const void *msgs, int count)
+{
+  return msgq_send_common(msgq, msgs, count, 1);
+}
+
+
+/****************************************************************************
+ * Name: msgq_trysend
+ *
+ * Description:
+ *  Send one message only if there is room for it, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_trysend(msgq_t *msgq, const void *msg)
+{
+  return msgq_send_common(msgq, msg, 1, 0);
+}
+
+
+/****************************************************************************
+ * Name: msgq_sendISR
+ *
+ * Description:
+ *  Send one message from ISR, without waiting. A waiting receiver gets it
+ *  directly and runs at the next context switch.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Message to be copied.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is full or for errors.
+ *
+ * Assumptions:
+ *  Should be called from ISR ONLY.
+ *
+ ****************************************************************************/
+
+int msgq_sendISR(msgq_t *msgq, const void *msg)
+{
+  task_t *woken = NULL;
+
+  if (!msgq || !msg)
+    {
+      return 0;
+    }
+
+  return msgq_send_crit(msgq, msg, &woken);
+}
+
+
+/****************************************************************************
+ * Name: msgq_recv
+ *
+ * Description:
+ *  Receive one message, blocking the current task while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recv(msgq_t *msgq, void *msg)
+{
+  return msgq_recv_common(msgq, msg, 1, 1);
+}
+
+
+/****************************************************************************
+ * Name: msgq_recvn
+ *
+ * Description:
+ *  Receive up to count messages in one step. The current task is blocked
+ *  only while the queue is empty.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msgs - Buffer for count messages.
+ *  count - Maximum number of messages.
+ *
+ * Returned Value:
+ *  Number of received messages, at least one.
+ *  0 - For errors.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_recvn(msgq_t *msgq, void *msgs, int count)
+{
+  return msgq_recv_common(msgq, msgs, count, 1);
+}
+
+
+/****************************************************************************
+ * Name: msgq_tryrecv
+ *
+ * Description:
+ *  Receive one message only if there is any, without waiting.
+ *
+ * Input Parameters:
+ *  msgq - Pointer to message queue.
+ *  msg - Buffer for one message.
+ *
+ * Returned Value:
+ *  1 - For success.
+ *  0 - If the queue is empty or for errors.
+ *
+ * Assumptions:
+ *  Called from task context, not from ISR.
+ *
+ ****************************************************************************/
+
+int msgq_tryrecv(msgq_t *msgq, void *msg)
+{
+  return msgq_recv_common(msgq, msg, 1, 0);
+}
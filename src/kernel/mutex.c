@@ -0,0 +1,459 @@
+/*
+ * mutex.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: yo3bn
+ */
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "config.h"
+#include "cpu.h"
+#include "kernel.h"
+#include "kernel_api.h"
+#include "task.h"
+#include "scheduler.h"
+#include "mutex.h"
+#include "context.h"
+
+
+/****************************************************************************
+ * Private functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mutex_waitq_insert
+ *
+ * Description:
+ *  Insert a task into the wait list of the mutex, sorted by priority.
+ *  Tasks having the same priority are kept in FIFO order.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *  task - Waiting task.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void mutex_waitq_insert(mutex_t *mutex, task_t *task)
+{
+  task_t *prev = NULL;
+  task_t *node = mutex->wait_head;
+
+  while (node && node->priority <= task->priority)
+    {
+      prev = node;
+      node = node->queue_next;
+    }
+
+  task->queue_next = node;
+
+  if (prev)
+    {
+      prev->queue_next = task;
+    }
+  else
+    {
+      mutex->wait_head = task;
+    }
+}
+
+
+/****************************************************************************
+ * Name: mutex_waitq_remove
+ *
+ * Description:
+ *  Remove a task from the wait list of the mutex.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *  task - Waiting task.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void mutex_waitq_remove(mutex_t *mutex, task_t *task)
+{
+  task_t **link;
+
+  for (link = (task_t**) &mutex->wait_head; *link;
+       link = &(*link)->queue_next)
+    {
+      if (*link == task)
+        {
+          *link = task->queue_next;
+          break;
+        }
+    }
+
+  task->queue_next = NULL;
+}
+
+
+/****************************************************************************
+ * Name: mutex_acquire
+ *
+ * Description:
+ *  Make the task the owner of a free mutex.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *  task - New owner.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void mutex_acquire(mutex_t *mutex, task_t *task)
+{
+  mutex->owner = task;
+  mutex->count = 1;
+  mutex->held_next = task->mutex_held;
+  task->mutex_held = mutex;
+}
+
+
+/****************************************************************************
+ * Name: mutex_release
+ *
+ * Description:
+ *  Remove the mutex from the list of mutexes held by its owner.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+static void mutex_release(mutex_t *mutex)
+{
+  mutex_t **link;
+
+  for (link = (mutex_t**) &mutex->owner->mutex_held; *link;
+       link = (mutex_t**) &(*link)->held_next)
+    {
+      if (*link == mutex)
+        {
+          *link = mutex->held_next;
+          break;
+        }
+    }
+
+  mutex->held_next = NULL;
+  mutex->owner = NULL;
+  mutex->count = 0;
+}
+
+
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: mutex_init
+ *
+ * Description:
+ *  Initialize an unlocked mutex.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+void mutex_init(mutex_t *mutex)
+{
+  if (!mutex)
+    {
+      return;
+    }
+
+  mutex->owner = NULL;
+  mutex->count = 0;
+  mutex->wait_head = NULL;
+  mutex->held_next = NULL;
+}
+
+
+/****************************************************************************
+ * Name: mutex_trylock
+ *
+ * Description:
+ *  Lock the mutex only if it is free or already owned by the current task.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_BUSY - The mutex is owned by other task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_trylock(mutex_t *mutex)
+{
+  MUTEX_STATUS_T retval = MUTEX_STATUS_ERROR;
+  task_t *task = (task_t*) g_running_task;
+
+  if (!mutex || !task)
+    {
+      return retval;
+    }
+
+  disable_interrupts();
+  if (!mutex->owner)
+    {
+      mutex_acquire(mutex, task);
+      retval = MUTEX_STATUS_SUCCESS;
+    }
+  else if (mutex->owner == task)
+    {
+      /* Recursive lock, the count must not wrap around. */
+
+      if (mutex->count < 0xFF)
+        {
+          mutex->count++;
+          retval = MUTEX_STATUS_SUCCESS;
+        }
+    }
+  else
+    {
+      retval = MUTEX_STATUS_BUSY;
+    }
+  enable_interrupts();
+
+  return retval;
+}
+
+
+/****************************************************************************
+ * Name: mutex_lock
+ *
+ * Description:
+ *  Lock the mutex, blocking the current task until the owner unlocks it.
+ *  The owner can lock it again, then it has to unlock it as many times.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex is owned by the current task.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_lock(mutex_t *mutex)
+{
+  MUTEX_STATUS_T retval;
+  task_t *task = (task_t*) g_running_task;
+
+  retval = mutex_trylock(mutex);
+  if (retval != MUTEX_STATUS_BUSY)
+    {
+      return retval;
+    }
+
+  disable_interrupts();
+
+  /* The owner could have unlocked it meanwhile. */
+
+  if (!mutex->owner)
+    {
+      mutex_acquire(mutex, task);
+      enable_interrupts();
+      return MUTEX_STATUS_SUCCESS;
+    }
+
+  /* Wait by priority, then lend the priority to the owner. */
+
+  task->wait_obj = mutex;
+  task->state = TASK_STATE_MUTEX_WAIT;
+  mutex_waitq_insert(mutex, task);
+  mutex_priority_update((task_t*) mutex->owner);
+
+  enable_interrupts();
+
+  /* Block until the mutex is handed over by its owner, the task is made
+   * ready only by then.
+   */
+
+  context_switch_to_kernel();
+
+  return MUTEX_STATUS_SUCCESS;
+}
+
+
+/****************************************************************************
+ * Name: mutex_unlock
+ *
+ * Description:
+ *  Unlock the mutex. When the last recursive lock is released, the mutex is
+ *  handed to the highest priority waiting task and the inherited priority
+ *  of the current task is dropped.
+ *
+ * Input Parameters:
+ *  mutex - Pointer to mutex.
+ *
+ * Returned Value:
+ *  MUTEX_STATUS_SUCCESS - The mutex was unlocked.
+ *  MUTEX_STATUS_NOT_OWNER - The current task does not own the mutex.
+ *  MUTEX_STATUS_ERROR - If error encountered.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *  If the new owner has a higher priority, the current task yields.
+ *
+ ****************************************************************************/
+
+MUTEX_STATUS_T mutex_unlock(mutex_t *mutex)
+{
+  task_t *task = (task_t*) g_running_task;
+  task_t *next;
+
+  if (!mutex || !task)
+    {
+      return MUTEX_STATUS_ERROR;
+    }
+
+  disable_interrupts();
+
+  if (mutex->owner != task)
+    {
+      enable_interrupts();
+      return MUTEX_STATUS_NOT_OWNER;
+    }
+
+  if (--mutex->count)
+    {
+      enable_interrupts();
+      return MUTEX_STATUS_SUCCESS;
+    }
+
+  mutex_release(mutex);
+
+  /* Hand the mutex to the first waiting task, which inherits the
+   * priorities of the remaining ones.
+   */
+
+  if ((next = mutex->wait_head))
+    {
+      mutex->wait_head = next->queue_next;
+      next->queue_next = NULL;
+      next->wait_obj = NULL;
+
+      mutex_acquire(mutex, next);
+
+      next->state = TASK_STATE_READY;
+      sched_ready_insert(next);
+      mutex_priority_update(next);
+    }
+
+  /* Drop the priority inherited through this mutex. */
+
+  mutex_priority_update(task);
+  enable_interrupts();
+
+  /* Let the higher priority owner run now. */
+
+  sched_yield_if_higher(next);
+
+  return MUTEX_STATUS_SUCCESS;
+}
+
+
+/****************************************************************************
+ * Name: mutex_priority_update
+ *
+ * Description:
+ *  Recompute the effective priority of a task, being the highest between
+ *  its base priority and the priorities of the tasks waiting for the
+ *  mutexes it holds. The change is propagated along the chain of owners,
+ *  when the task itself waits for a mutex.
+ *
+ * Input Parameters:
+ *  task - Task to be updated.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Called from critical section.
+ *
+ ****************************************************************************/
+
+void mutex_priority_update(task_t *task)
+{
+  mutex_t *held;
+  mutex_t *waiting;
+  unsigned char prio;
+
+  while (task)
+    {
+      /* The first waiter of each mutex has the highest priority. */
+
+      prio = task->base_priority;
+      for (held = (mutex_t*) task->mutex_held; held;
+           held = (mutex_t*) held->held_next)
+        {
+          if (held->wait_head && held->wait_head->priority < prio)
+            {
+              prio = held->wait_head->priority;
+            }
+        }
+
+      if (prio == task->priority)
+        {
+          return;
+        }
+
+      if (task->state != TASK_STATE_MUTEX_WAIT)
+        {
+          sched_setpriority(task, prio);
+          return;
+        }
+
+      /* Keep the wait list sorted, then continue with its owner. */
+
+      waiting = (mutex_t*) task->wait_obj;
+      mutex_waitq_remove(waiting, task);
+      task->priority = prio;
+      mutex_waitq_insert(waiting, task);
+
+      task = (task_t*) waiting->owner;
+    }
+}
@@ -12,6 +12,7 @@
 
 #include "config.h"
 #include "arch.h"
+#include "cpu.h"
 #include "private.h"
 #include "kernel.h"
 #include "klib.h"
@@ -20,141 +21,444 @@
 #include "scheduler.h"
 #include "semaphore.h"
 #include "context.h"
+#include "kernel_api.h"
+
+
+/****************************************************************************
+ * Private data.
+ ****************************************************************************/
+
+/* Ready Queue
+ *
+ * Ready tasks are kept in one FIFO list per priority, linked through
+ * task->queue_next. Bit N of the bitmap is set while the list of
+ * priority N is not empty, thus the highest priority ready task is found
+ * without walking the task list.
+ *
+ * Tasks are made ready from ISR too (semaphores given), thus the queue is
+ * changed only having interrupts disabled.
+ */
+
+static struct
+{
+  task_t *head;                             /* First task to be run. */
+  task_t *tail;                             /* Last inserted task. */
+} g_ready_list[CONFIG_TASK_PRIORITIES];
+
+static volatile unsigned char g_ready_bitmap;
+
+
+/* Lowest bit set in a nibble, used to scan the ready bitmap in constant
+ * time. Index zero is never used.
+ */
+
+static const unsigned char g_nibble_lsb[16] =
+{
+  0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
+
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: scheduler_init
+ *
+ * Description:
+ *    Empty the ready queue.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called once from kernel initialization, before creating any task.
+ *
+ ****************************************************************************/
+
+void scheduler_init(void)
+{
+  kmemset((void*) g_ready_list, 0, sizeof(g_ready_list));
+  g_ready_bitmap = 0;
+}
+
+
+/****************************************************************************
+ * Name: sched_ready_insert
+ *
+ * Description:
+ *    Append a task at the end of the ready queue of its priority.
+ *
+ * Input Parameters:
+ *    task - Task which just entered the READY state.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *    The task is not already in the ready queue.
+ *
+ ****************************************************************************/
+
+void sched_ready_insert(task_t *task)
+{
+  unsigned char prio;
+
+  if (!task)
+    {
+      return;
+    }
+
+  prio = task->priority;
+  task->queue_next = NULL;
+
+  if (g_ready_list[prio].head)
+    {
+      g_ready_list[prio].tail->queue_next = task;
+    }
+  else
+    {
+      g_ready_list[prio].head = task;
+      g_ready_bitmap |= (unsigned char) (1 << prio);
+    }
+
+  g_ready_list[prio].tail = task;
+}
+
+
+/****************************************************************************
+ * Name: sched_ready_remove
+ *
+ * Description:
+ *    Remove a task from the ready queue of its priority.
+ *
+ * Input Parameters:
+ *    task - Task which is leaving the READY state.
+ *
+ * Returned Value:
+ *    1 - If the task was found and removed.
+ *    0 - If the task was not in the ready queue.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    Used only for uncommon transitions (priority change, pausing), since
+ *    the list of the priority is walked.
+ *
+ ****************************************************************************/
+
+int sched_ready_remove(task_t *task)
+{
+  unsigned char prio;
+  task_t *prev = NULL;
+  task_t *node;
+
+  if (!task)
+    {
+      return 0;
+    }
+
+  prio = task->priority;
+  node = g_ready_list[prio].head;
+
+  while (node && node != task)
+    {
+      prev = node;
+      node = node->queue_next;
+    }
+
+  if (!node)
+    {
+      return 0;
+    }
+
+  /* Unlink the node and fix the list ends. */
+
+  if (prev)
+    {
+      prev->queue_next = task->queue_next;
+    }
+  else
+    {
+      g_ready_list[prio].head = task->queue_next;
+    }
+
+  if (g_ready_list[prio].tail == task)
+    {
+      g_ready_list[prio].tail = prev;
+    }
+
+  if (!g_ready_list[prio].head)
+    {
+      g_ready_bitmap &= (unsigned char) ~(1 << prio);
+    }
+
+  task->queue_next = NULL;
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: sched_setpriority
+ *
+ * Description:
+ *    Change the effective priority of a task. A ready task is moved at the
+ *    end of its new priority queue, otherwise it will be queued with the
+ *    new priority when it becomes ready.
+ *
+ * Input Parameters:
+ *    task - Task to be changed.
+ *    priority - New priority, lower than CONFIG_TASK_PRIORITIES.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *
+ ****************************************************************************/
+
+void sched_setpriority(task_t *task, unsigned char priority)
+{
+  if (!task || task->priority == priority)
+    {
+      return;
+    }
+
+  if (task->state == TASK_STATE_READY && sched_ready_remove(task))
+    {
+      task->priority = priority;
+      sched_ready_insert(task);
+    }
+  else
+    {
+      task->priority = priority;
+    }
+}
+
+
+/****************************************************************************
+ * Name: sched_ready_pop
+ *
+ * Description:
+ *    Remove and return the first task of the highest priority ready queue.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    Pointer to task - If there is any ready task.
+ *    NULL - If no task is ready.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    Runs in constant time, no matter how many tasks exist.
+ *
+ ****************************************************************************/
+
+task_t *sched_ready_pop(void)
+{
+  unsigned char bitmap = g_ready_bitmap;
+  unsigned char prio;
+  task_t *task;
+
+  if (!bitmap)
+    {
+      return NULL;
+    }
+
+  /* Find the lowest bit set, which is the highest priority. */
+
+  if (bitmap & 0x0F)
+    {
+      prio = g_nibble_lsb[bitmap & 0x0F];
+    }
+  else
+    {
+      prio = g_nibble_lsb[bitmap >> 4] + 4;
+    }
+
+  /* Take the first task from list. */
+
+  task = g_ready_list[prio].head;
+  g_ready_list[prio].head = task->queue_next;
+
+  if (!g_ready_list[prio].head)
+    {
+      g_ready_list[prio].tail = NULL;
+      g_ready_bitmap &= (unsigned char) ~(1 << prio);
+    }
+
+  task->queue_next = NULL;
+  return task;
+}
+
+
+/****************************************************************************
+ * Name: sched_ready_pending
+ *
+ * Description:
+ *    Check if any task is ready to run.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    1 - If at least one task is into the ready queue.
+ *    0 - If no task is ready.
+ *
+ * Assumptions:
+ *    The bitmap is one byte long, thus it is read atomically.
+ *
+ ****************************************************************************/
+
+int sched_ready_pending(void)
+{
+  return g_ready_bitmap != 0;
+}
+
+
+/****************************************************************************
+ * Name: sched_wait_append_crit
+ *
+ * Description:
+ *    Append a task at the end of the FIFO wait list of a kernel object,
+ *    linked through task->queue_next like the ready queue.
+ *
+ * Input Parameters:
+ *    head - Wait list of the object.
+ *    task - Task which is going to wait.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *    The task is not into any other queue.
+ *
+ ****************************************************************************/
+
+void sched_wait_append_crit(task_t **head, task_t *task)
+{
+  task_t **link = head;
+
+  while (*link)
+    {
+      link = &(*link)->queue_next;
+    }
+
+  task->queue_next = NULL;
+  *link = task;
+}
+
+
+/****************************************************************************
+ * Name: sched_yield_if_higher
+ *
+ * Description:
+ *    Yield to a task just made ready, if it has a higher priority than the
+ *    running task. The kernel itself never yields.
+ *
+ * Input Parameters:
+ *    woken - Task just made ready, or NULL.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called having interrupts enabled, after the object was changed.
+ *
+ ****************************************************************************/
+
+void sched_yield_if_higher(task_t *woken)
+{
+  task_t *task = (task_t*) g_running_task;
+
+  if (woken && task && task != g_task_list_head &&
+      woken->priority < task->priority)
+    {
+      yield();
+    }
+}
 
 
 /****************************************************************************
  * Name: scheduler
  *
  * Description:
- *    Round Robin task scheduler.
+ *    Priority based, Round Robin task scheduler.
  *
- *    Cycle through all tasks in the task array and change their states
- *    accordingly to the received event parameter.
+ *    Run the ready tasks, highest priority first. Tasks having the
+ *    same priority are run in Round Robin order.
  *
  *    Do all possible task computation until all tasks are
- *    blocked/waiting/sleeping then return.
+ *    blocked/waiting/sleeping, or until new events arrive, then return.
  *
  * Input Parameters:
- *    event - Received Kernel Event.
+ *    none
  *
  * Returned Value:
- *    Since there is no other work or event generated by the scheduler, the
- *    return value is zero at the moment.
+ *    none
  *
  * Assumptions:
+ *    Called from kernel loop, after the event handlers changed the task
+ *    states accordingly to the received event.
  *
  ****************************************************************************/
 
-int scheduler(kernel_event_t *event)
+void scheduler(void)
 {
-  int work_todo  = 0;
-
-  task_t *task = NULL;
+  task_t *task;
 
-  /* Do all possible work for the received event,
-   * most likely until all tasks are blocked/waiting/sleeping.
+  /* Do all possible work, most likely until all
+   * tasks are blocked/waiting/sleeping. The next task is always taken from
+   * the ready queue, without going through the task list.
    */
 
-  do
+  for (;;)
     {
-      work_todo = 0;
+      /* Interrupts are kept disabled until the task context is restored,
+       * thus the systick cannot see the task as running while still on
+       * the kernel stack.
+       */
 
-      /* Go through all tasks and take decisions based on their statuses. */
+      disable_interrupts();
+      task = sched_ready_pop();
 
-      while (task_getnext(&task))
+      if (!task)
         {
-          switch (task->state)
-          {
-            /* These statements are priority ordered.
-             * Do not change the order.
-             */
-
-            case TASK_STATE_READY:
-               /* Run the task, also mark it as RUNNING. */
-
-               g_running_task = task;
-               g_running_task->state = TASK_STATE_RUNNING;
-               context_switch_to_task();
-               g_running_task = g_task_list_head;
-
-               /* Re-mark it as READY if there was no request
-                * to change the state.
-                *
-                * For example, this happens when the task exited simply
-                * using return.
-                */
-
-               if (task->state == TASK_STATE_RUNNING)
-                 {
-                   task->state = TASK_STATE_READY;
-                   work_todo = 1;
-                 }
-               break;
-
-/*
-            case TASK_STATE_IO_WAIT:
-               if (event->type == KERNEL_EVENT_IO_RCVD)
-                 {
-                   //TODO check_io_for_this_task();
-                   //TODO if yes, then set it ready to run and set work to do.
-                 }
-               break;*/
-
-
-            case TASK_STATE_RESUMED:
-                task->state = task->last_state;
-                if (task->state == TASK_STATE_RUNNING)
-                  {
-                    task->state = TASK_STATE_READY;
-                    work_todo = 1;
-                  }
-                break;
-
-
-            case TASK_STATE_PAUSED:
-               /* Just skip it, but note that delay is not
-                * decremented anymore.
-                */
-
-               break;
-
-
-            case TASK_STATE_SLEEP:
-               if (event->type == KERNEL_EVENT_IRQ_SYSTICK)
-                 {
-                   //TODO get g_systicks in critical section
-                   if (g_systicks >= task->wakeup_ticks)
-                     {
-                       task->wakeup_ticks = 0;
-                       task->state = TASK_STATE_READY;
-                       work_todo = 1;
-                     }
-                 }
-               break;
-
-
-            case TASK_STATE_EXITED:
-               //TODO some cleanup and remove it from task array.
-               break;
-
-
-            default:
-              break;
-          } /* switch (task->state) */
-        } /* while (task_getnext(&task)) */
-
-      /* Reached end of task list. Set task to NULL in order to get
-       * first task at next iteration if still more work to do.
+          enable_interrupts();
+          break;
+        }
+
+      /* Run the task, also mark it as RUNNING. */
+
+      g_running_task = task;
+      g_running_task->state = TASK_STATE_RUNNING;
+      g_running_task->slice = task->quantum;
+      context_switch_to_task();
+
+      /* Other tasks could be run directly from task to task meanwhile.
+       * Every path back to kernel already queued the task as ready if it
+       * was still running, and marked the kernel as running.
+       *
+       * For example, this happens when the task called yield(), or
+       * when its time slice was used up.
        */
 
-      task = NULL;
-    }
-  while (work_todo);
+      enable_interrupts();
 
-  /* Always return 0, since scheduler never generate
-   * events or other work, at least for the moment.
-   */
+      /* Let the kernel consume the new events first, the remaining
+       * ready tasks are run by the next scheduler call.
+       */
 
-  return 0;
+      if (kevent_pending())
+        {
+          break;
+        }
+    }
 }
-
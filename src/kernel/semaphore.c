@@ -10,72 +10,93 @@
 #include "kernel.h"
 #include "kernel_api.h"
 #include "task.h"
+#include "scheduler.h"
 #include "semaphore.h"
+#include "timers.h"
 #include "context.h"
 
 
 /****************************************************************************
- * Public functions.
+ * Private functions.
  ****************************************************************************/
 
 
 /****************************************************************************
- * Name: sem_init
+ * Name: sem_post_crit
  *
  * Description:
- *  Initialize a semaphore.
+ *  Give one resource. If a task is waiting, the resource is handed directly
+ *  to the first one, which is made ready at once. No kernel event is
+ *  needed and the woken task does not have to take the semaphore again.
+ *  Otherwise, the count of free resources is incremented.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
  *
  * Returned Value:
- *  none
+ *  Pointer to the woken task, or NULL.
  *
  * Assumptions:
- *  Should not be called before kernel initialization.
+ *  Called from ISR or critical section.
  *
  ****************************************************************************/
 
-void sem_init(semaphore_t *sem)
+static task_t *sem_post_crit(semaphore_t *sem)
 {
-  if (!sem)
+  task_t *task = sem->wait_head;
+
+  if (!task)
     {
-      return;
+      if (sem->resources < SEM_COUNT_MAX)
+        {
+          sem->resources++;
+        }
+
+      return NULL;
     }
 
-  sem->resources = 0;
-  sem->waiting_task = 0;
+  sem->wait_head = task->queue_next;
+  if (!sem->wait_head)
+    {
+      sem->wait_tail = NULL;
+    }
+
+  /* A timed wait ends here, not by its timeout. */
+
+  sleepq_remove_crit(task);
+
+  task->queue_next = NULL;
+  task->wait_obj = NULL;
+  task->state = TASK_STATE_READY;
+  sched_ready_insert(task);
+
+  return task;
 }
 
 
 /****************************************************************************
- * Name: sem_take
+ * Name: sem_take_common
  *
  * Description:
- *  Block the current task till the specified semaphore or resource is given.
- *  Take the semaphore using a waiting type.
- *  This function does not block, but it will return a specific state for
- *  waiting.
+ *  Take one resource from the semaphore. If none is free and waiting was
+ *  requested, the current task is appended to the wait list and blocked,
+ *  optionally for a limited number of ticks.
  *
  * Input Parameters:
  *  sem - Semaphore pointer.
- *  wait - Wait type. Waiting forever, or no waiting at all.
+ *  wait - Wait type. Waiting, or no waiting at all.
+ *  ticks - Maximum number of ticks to wait, zero for waiting forever.
  *
  * Returned Value:
- *  SEM_STATUS_ERROR - If error encountered.
- *  SEM_STATUS_TOOK - If semaphore was took.
- *  SEM_STATUS_WAIT - If the semaphore is not available.
- *                    The task will not be called after exit, thus until
- *                    semaphore is available.
- *  SEM_STATUS_BUSY - If the waiting type is WAIT_NO, this is returned when
- *                    the semaphore is not available.
+ *  See, sem_timedtake().
  *
  * Assumptions:
  *  Called only from a valid task, not from kernel, nor from ISR.
  *
  ****************************************************************************/
 
-SEM_STATUS_T sem_take(semaphore_t *sem, SEM_WAIT_T wait)
+static SEM_STATUS_T sem_take_common(semaphore_t *sem, SEM_WAIT_T wait,
+                                    unsigned int ticks)
 {
   SEM_STATUS_T retval = SEM_STATUS_ERROR;
   task_t *task = (task_t*) g_running_task;
@@ -85,19 +106,42 @@ SEM_STATUS_T sem_take(semaphore_t *sem, SEM_WAIT_T wait)
       return retval;
     }
 
-again:
   disable_interrupts();
   if (sem->resources > 0)
     {
-      sem->resources = 0;
+      sem->resources--;
       retval = SEM_STATUS_TOOK;
     }
   else
     {
       if (wait)
         {
-          sem->waiting_task = task->id;
+          /* Append the task to the wait list. */
+
+          task->queue_next = NULL;
+          if (sem->wait_tail)
+            {
+              sem->wait_tail->queue_next = task;
+            }
+          else
+            {
+              sem->wait_head = task;
+            }
+
+          sem->wait_tail = task;
+          task->wait_obj = sem;
+          task->flags &= ~TASK_FLAG_TIMEDOUT;
           task->state = TASK_STATE_SEM_WAIT;
+
+          /* Bound the wait. No work is done per tick for this task, till
+           * it gets to the head of the sleep queue.
+           */
+
+          if (ticks)
+            {
+              sleepq_insert_crit(task, ticks);
+            }
+
           retval = SEM_STATUS_WAIT;
         }
       else
@@ -107,25 +151,167 @@ again:
     }
   enable_interrupts();
 
-  /* FIXME Simulate blocking function here.
-   * TODO Implement blocking functions.
+  /* Block until a resource is handed over by sem_give() or the time is
+   * over. The task is made ready only by then, thus it does not have to
+   * take the semaphore again.
    */
 
   if (retval == SEM_STATUS_WAIT)
     {
       context_switch_to_kernel();
-      goto again;
+
+      if (task->flags & TASK_FLAG_TIMEDOUT)
+        {
+          task->flags &= ~TASK_FLAG_TIMEDOUT;
+          retval = SEM_STATUS_TIMEOUT;
+        }
+      else
+        {
+          retval = SEM_STATUS_TOOK;
+        }
     }
 
   return retval;
 }
 
 
+/****************************************************************************
+ * Public functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: sem_init
+ *
+ * Description:
+ *  Initialize a semaphore.
+ *
+ * Input Parameters:
+ *  sem - Pointer to semaphore.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *
+ ****************************************************************************/
+
+void sem_init(semaphore_t *sem)
+{
+  sem_init2(sem, 0);
+}
+
+
+/****************************************************************************
+ * Name: sem_init2
+ *
+ * Description:
+ *  Initialize a counting semaphore having some free resources.
+ *
+ * Input Parameters:
+ *  sem - Pointer to semaphore.
+ *  count - Initial number of free resources, up to SEM_COUNT_MAX.
+ *
+ * Returned Value:
+ *  none
+ *
+ * Assumptions:
+ *  Should not be called before kernel initialization.
+ *
+ ****************************************************************************/
+
+void sem_init2(semaphore_t *sem, int count)
+{
+  if (!sem)
+    {
+      return;
+    }
+
+  if (count < 0)
+    {
+      count = 0;
+    }
+  else if (count > SEM_COUNT_MAX)
+    {
+      count = SEM_COUNT_MAX;
+    }
+
+  sem->resources = count;
+  sem->wait_head = NULL;
+  sem->wait_tail = NULL;
+}
+
+
+/****************************************************************************
+ * Name: sem_take
+ *
+ * Description:
+ *  Take one resource from the semaphore using a waiting type.
+ *  If none is free and waiting was requested, the current task is blocked
+ *  at the end of the wait list, until a resource is handed to it.
+ *
+ * Input Parameters:
+ *  sem - Semaphore pointer.
+ *  wait - Wait type. Waiting forever, or no waiting at all.
+ *
+ * Returned Value:
+ *  SEM_STATUS_ERROR - If error encountered.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
+ *  SEM_STATUS_BUSY - If the waiting type is WAIT_NO, this is returned when
+ *                    the semaphore is not available.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+SEM_STATUS_T sem_take(semaphore_t *sem, SEM_WAIT_T wait)
+{
+  return sem_take_common(sem, wait, 0);
+}
+
+
+/****************************************************************************
+ * Name: sem_timedtake
+ *
+ * Description:
+ *  Take one resource from the semaphore, waiting at most a number of ticks.
+ *  The task waits both into the wait list of the semaphore and into the
+ *  sleep queue, thus it is woken by whichever comes first.
+ *
+ * Input Parameters:
+ *  sem - Semaphore pointer.
+ *  ticks - Maximum number of ticks to wait. Zero means no waiting at all.
+ *
+ * Returned Value:
+ *  SEM_STATUS_ERROR - If error encountered.
+ *  SEM_STATUS_TOOK - If semaphore was took, immediately or after waiting.
+ *  SEM_STATUS_BUSY - If ticks is zero and the semaphore is not available.
+ *  SEM_STATUS_TIMEOUT - If no resource was handed over in time.
+ *
+ * Assumptions:
+ *  Called only from a valid task, not from kernel, nor from ISR.
+ *
+ ****************************************************************************/
+
+SEM_STATUS_T sem_timedtake(semaphore_t *sem, unsigned int ticks)
+{
+  if (!ticks)
+    {
+      return sem_take_common(sem, SEM_WAIT_NO, 0);
+    }
+
+  return sem_take_common(sem, SEM_WAIT_FOREVER, ticks);
+}
+
+
 /****************************************************************************
  * Name: sem_giveISR
  *
  * Description:
- *  Give semaphore from ISR.
+ *  Give semaphore from ISR. The resource is handed to the first waiting
+ *  task, if any, which runs at the next context switch.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -145,8 +331,7 @@ void sem_giveISR(semaphore_t *sem)
       return;
     }
 
-  sem->resources = 1;
-  kput_event_crit(KERNEL_EVENT_SEM_GIVEN, (void*) sem);
+  sem_post_crit(sem);
 }
 
 
@@ -154,7 +339,9 @@ void sem_giveISR(semaphore_t *sem)
  * Name: sem_give
  *
  * Description:
- *  Give semaphore for a resource.
+ *  Give semaphore for a resource. The resource is handed to the first
+ *  waiting task, if any. If it has a higher priority, the current task
+ *  yields to it.
  *
  * Input Parameters:
  *  sem - Pointer to semaphore.
@@ -169,93 +356,79 @@ void sem_giveISR(semaphore_t *sem)
 
 SEM_STATUS_T sem_give(semaphore_t *sem)
 {
+  task_t *task;
+
   if (!sem)
     {
       return SEM_STATUS_ERROR;
     }
 
   disable_interrupts();
-  sem->resources = 1;
-  kput_event_crit(KERNEL_EVENT_SEM_GIVEN, (void*) sem);
+  task = sem_post_crit(sem);
   enable_interrupts();
 
+  /* Let the woken task run now, if it has a higher priority. */
+
+  sched_yield_if_higher(task);
+
   return SEM_STATUS_SUCCESS;
 }
 
 
 /****************************************************************************
- * Name: semaphores
+ * Name: sem_wait_cancel_crit
  *
  * Description:
- *  Process events related to semaphores.
+ *  Remove a task from the wait list of the semaphore it waits on, when its
+ *  timed wait has expired.
  *
  * Input Parameters:
- *  event - Event from kernel.
+ *  task - Task waiting into TASK_STATE_SEM_WAIT.
  *
  * Returned Value:
- *  1 - If there is further work to do by kernel.
- *  0 - If there is no further work to do.
+ *  none
  *
  * Assumptions:
- *  Called from kernel loop only.
+ *  Called from critical section, in kernel context.
+ *  The caller changes the task state.
  *
  ****************************************************************************/
 
-int semaphores(kernel_event_t *event)
+void sem_wait_cancel_crit(task_t *task)
 {
-  semaphore_t *sem;
-  task_t *task = NULL;
-  unsigned id = 0;
-  int retval = 0;
+  semaphore_t *sem = (semaphore_t*) task->wait_obj;
+  task_t *prev = NULL;
+  task_t *node;
 
-  if (!event)
-    {
-      return 0;
-    }
-
-  if (event->type != KERNEL_EVENT_SEM_GIVEN)
-    {
-      return 0;
-    }
-
-  sem = (semaphore_t *) event->data;
   if (!sem)
     {
-      return 0;
+      return;
     }
 
-  /* Get the waiting task for this semaphore. */
-
-  disable_interrupts();
-  id = sem->waiting_task;
-  enable_interrupts();
-
-  /* If there is nothing in the waiting queue, then some module gave the
-   * semaphore and none is waiting for it.
-   */
-
-  if (id)
+  for (node = sem->wait_head; node; prev = node, node = node->queue_next)
     {
-      task = task_getby_id(id);
-
-      /* Check if task is still alive. */
+      if (node != task)
+        {
+          continue;
+        }
 
-      if (task)
+      if (prev)
         {
-          task->state = TASK_STATE_READY;
-          retval = 1;
+          prev->queue_next = task->queue_next;
+        }
+      else
+        {
+          sem->wait_head = task->queue_next;
         }
-    }
 
-  /* Clear this event, even if the task was found or not.
-   * This will prevent the kernel to enter into a never-ending loop by
-   * processing it over and over again.
-   *
-   * TODO: Not sure if this is the correct solution. Please, find a better
-   * approach if possible. Maybe mark it as consumed?
-   */
+      if (sem->wait_tail == task)
+        {
+          sem->wait_tail = prev;
+        }
 
-  kmemset((void*) event, 0, sizeof(kernel_event_t));
+      break;
+    }
 
-  return retval;
+  task->queue_next = NULL;
+  task->wait_obj = NULL;
 }
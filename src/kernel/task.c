@@ -15,8 +15,13 @@
 #include "cpu.h"
 #include "private.h"
 #include "kernel.h"
+#include "kernel_api.h"
 #include "task.h"
 #include "timers.h"
+#include "scheduler.h"
+#include "semaphore.h"
+#include "mutex.h"
+#include "eventflags.h"
 #include "klib.h"
 #include "context.h"
 
@@ -29,18 +34,441 @@ volatile task_t *g_task_list_head;
 volatile task_t *g_running_task;
 volatile unsigned char *g_stack_pointer;
 volatile unsigned char *g_stack_head;
+volatile unsigned char *g_stack_limit;
+
+
+/****************************************************************************
+ * Private types.
+ ****************************************************************************/
+
+/* Free region of the task area, the header being stored at its lowest
+ * address. The list is sorted by address, thus neighbours are coalesced.
+ */
+
+typedef struct task_region_s
+{
+  unsigned int size;                    /* Region size in bytes. */
+  struct task_region_s *next;           /* Next free region, above. */
+} task_region_t;
 
 
 /****************************************************************************
  * Private globals.
  ****************************************************************************/
 
+/* Tasks are carved downwards from g_stack_head. The lowest address used so
+ * far is the break, regions freed above it are kept into the free list.
+ */
+
+static unsigned char *g_task_break;
+static task_region_t *g_task_free_head;
+
+
+/* Exited tasks waiting for the kernel to reclaim their memory. */
+
+static task_t *g_task_exited_head;
+
+
+/* Overflowed tasks whose report found the event buffer full. */
+
+static task_t *g_task_overflow_head;
+
+
+/* Task table indexed by the slot of the task ID, the kernel being into
+ * slot 0. The generation of a slot is advanced when its task is destroyed.
+ */
+
+static task_t *g_task_table[CONFIG_TASK_MAX];
+static unsigned char g_task_generation[CONFIG_TASK_MAX];
+
+static void task_reap_handler(kernel_event_t *event);
+
+/* Handler of KERNEL_EVENT_TASK_EXITED, subscribed by task_init(). */
+
+static kevent_handler_t g_task_reap_handler = { task_reap_handler, NULL };
+
+
+/****************************************************************************
+ * Private functions.
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Name: task_region_alloc_crit
+ *
+ * Description:
+ *    Find room for a task and its stack. The first free region which is
+ *    large enough is used, otherwise the region is carved below the break.
+ *
+ * Input/Output Parameters:
+ *    size - As an INPUT, the requested size in bytes.
+ *         - As an OUTPUT, the size given, which can be a few bytes larger
+ *            when the rest of the free region would be too small to be kept.
+ *
+ * Returned Value:
+ *    Pointer to the first byte above the region, its top.
+ *    NULL - If there is no room left above the static data.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *
+ ****************************************************************************/
+
+static unsigned char *task_region_alloc_crit(unsigned int *size)
+{
+  task_region_t **link = &g_task_free_head;
+  task_region_t *region;
+
+  while ((region = *link))
+    {
+      if (region->size >= *size)
+        {
+          /* Use the upper part, thus the header stays in place. */
+
+          if (region->size - *size >= sizeof(task_region_t))
+            {
+              region->size -= *size;
+              return (unsigned char*) region + region->size + *size;
+            }
+
+          *link = region->next;
+          *size = region->size;
+          return (unsigned char*) region + region->size;
+        }
+
+      link = &region->next;
+    }
+
+  /* Never carve over the static data. */
+
+  if ((unsigned int) (g_task_break - g_stack_limit) < *size)
+    {
+      return NULL;
+    }
+
+  g_task_break -= *size;
+  return g_task_break + *size;
+}
+
+
+/****************************************************************************
+ * Name: task_region_free_crit
+ *
+ * Description:
+ *    Give back the region of a task, merging it with its free neighbours.
+ *
+ * Input Parameters:
+ *    base - Lowest address of the region.
+ *    size - Region size in bytes.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section. The region is not used anymore.
+ *
+ ****************************************************************************/
+
+static void task_region_free_crit(unsigned char *base, unsigned int size)
+{
+  task_region_t **link = &g_task_free_head;
+  task_region_t *prev = NULL;
+  task_region_t *region;
+
+  /* A region at the break just moves it up, also over the free region
+   * which might follow.
+   */
+
+  if (base == g_task_break)
+    {
+      g_task_break += size;
+
+      region = g_task_free_head;
+      if ((unsigned char*) region == g_task_break)
+        {
+          g_task_break += region->size;
+          g_task_free_head = region->next;
+        }
+
+      return;
+    }
+
+  while (*link && (unsigned char*) *link < base)
+    {
+      prev = *link;
+      link = &prev->next;
+    }
+
+  region = (task_region_t*) base;
+  region->size = size;
+  region->next = *link;
+
+  if (region->next &&
+      base + size == (unsigned char*) region->next)
+    {
+      region->size += region->next->size;
+      region->next = region->next->next;
+    }
+
+  if (prev && (unsigned char*) prev + prev->size == base)
+    {
+      prev->size += region->size;
+      prev->next = region->next;
+      return;
+    }
+
+  *link = region;
+}
+
+
+/****************************************************************************
+ * Name: task_cancel_wait_crit
+ *
+ * Description:
+ *    Remove a task from the ready queue, from the sleep queue and from the
+ *    wait list of the object it is blocked on.
+ *
+ * Input Parameters:
+ *    task - Given task.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the task waits on an object which cannot be cancelled.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *
+ ****************************************************************************/
+
+static int task_cancel_wait_crit(task_t *task)
+{
+  switch (task->state)
+    {
+      case TASK_STATE_READY:
+        sched_ready_remove(task);
+        break;
+
+      case TASK_STATE_SEM_WAIT:
+        sem_wait_cancel_crit(task);
+        break;
+
+      case TASK_STATE_FLAGS_WAIT:
+        eventflags_wait_cancel_crit(task);
+        break;
+
+      case TASK_STATE_RUNNING:
+      case TASK_STATE_SLEEP:
+      case TASK_STATE_PAUSED:
+        break;
+
+      default:
+        return 0;
+    }
+
+  sleepq_remove_crit(task);
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: task_unlink_crit
+ *
+ * Description:
+ *    Remove a task from the task list and from the kernel queues, making
+ *    it unreachable.
+ *
+ * Input Parameters:
+ *    task - Task to be removed.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - If the task waits on an object which cannot be cancelled.
+ *
+ * Assumptions:
+ *    Called from critical section.
+ *
+ ****************************************************************************/
+
+static int task_unlink_crit(task_t *task)
+{
+  task_t **link;
+
+  if (!task_cancel_wait_crit(task))
+    {
+      return 0;
+    }
+
+  /* The next task using this slot gets another ID. */
+
+  g_task_table[task->id & TASK_ID_SLOT_MASK] = NULL;
+  g_task_generation[task->id & TASK_ID_SLOT_MASK]++;
+
+  for (link = (task_t**) &g_task_list_head; *link; link = &(*link)->next)
+    {
+      if (*link == task)
+        {
+          *link = task->next;
+          break;
+        }
+    }
+
+  /* Others should not be able to find it anymore by name or id. */
+
+  task->next = NULL;
+  task->id = 0;
+  task->name[0] = '\0';
+  task->state = TASK_STATE_EXITED;
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: task_release_crit
+ *
+ * Description:
+ *    Give back the memory of an unlinked task.
+ *
+ * Input Parameters:
+ *    task - Exited task.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section, not running on the stack of the task.
+ *
+ ****************************************************************************/
+
+static void task_release_crit(task_t *task)
+{
+  unsigned int size = task->stack_size + sizeof(task_t);
+  unsigned char *top = (unsigned char*) task + sizeof(task_t);
+
+  task_region_free_crit(top - size, size);
+}
+
+
+/****************************************************************************
+ * Name: task_reap_handler
+ *
+ * Description:
+ *    Reclaim the memory of the tasks which destroyed themselves, also post
+ *    the stack overflow reports which found the event buffer full.
+ *
+ * Input Parameters:
+ *    event - KERNEL_EVENT_TASK_EXITED event from kernel.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from kernel loop only, for the subscribed event type.
+ *
+ ****************************************************************************/
+
+static void task_reap_handler(kernel_event_t *event)
+{
+  task_t *task;
+
+  (void) event;
+
+  disable_interrupts();
+  while ((task = g_task_exited_head))
+    {
+      g_task_exited_head = task->queue_next;
+      task->queue_next = NULL;
+      task_release_crit(task);
+    }
+
+  while ((task = g_task_overflow_head))
+    {
+      if (!kput_event_crit(KERNEL_EVENT_STACK_OVERFLOW, task))
+        {
+          /* Still full, try again after the next event is consumed. */
+
+          kput_event_once_crit(KERNEL_EVENT_TASK_EXITED);
+          break;
+        }
+
+      g_task_overflow_head = task->queue_next;
+      task->queue_next = NULL;
+    }
+  enable_interrupts();
+}
+
+
+/****************************************************************************
+ * Name: task_exit
+ *
+ * Description:
+ *    Return address of every task function, destroying the task when its
+ *    function returns.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    Never returns.
+ *
+ * Assumptions:
+ *    Reached only by returning from the task function.
+ *
+ ****************************************************************************/
+
+static void task_exit(void)
+{
+  task_destroy(0);
+
+  /* Still holding a mutex, thus it cannot be destroyed. Never run it
+   * again, the memory is lost.
+   */
+
+  disable_interrupts();
+  g_running_task->state = TASK_STATE_EXITED;
+  enable_interrupts();
+
+  context_switch_to_kernel();
+}
+
 
 /****************************************************************************
  * Public functions.
  ****************************************************************************/
 
 
+/****************************************************************************
+ * Name: task_init
+ *
+ * Description:
+ *    Empty the task area and subscribe it to the task exit events.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called once from kernel initialization, before the kernel task is
+ *    created.
+ *
+ ****************************************************************************/
+
+void task_init(void)
+{
+  g_task_break = NULL;
+  g_task_free_head = NULL;
+  g_task_exited_head = NULL;
+  g_task_overflow_head = NULL;
+
+  kmemset(g_task_table, 0, sizeof(g_task_table));
+  kmemset(g_task_generation, 0, sizeof(g_task_generation));
+
+  kernel_subscribe(KERNEL_EVENT_TASK_EXITED, &g_task_reap_handler);
+}
+
+
 /****************************************************************************
  * Name: task_create
  *
@@ -57,7 +485,7 @@ volatile unsigned char *g_stack_head;
  *
  * Returned Value:
  *    1 - For success.
- *    0 - For errors.
+ *    0 - For errors, if the task table is full, or there is no memory left.
  *
  * Assumptions:
  *    Task name and entry point are mandatory.
@@ -67,9 +495,9 @@ volatile unsigned char *g_stack_head;
 int task_create(const char *name, void (*func)(void*),
                 void *arg, int stack_size)
 {
-  int i;
-  int id;
-  int stack_used;
+  int slot;
+  unsigned int size;
+  unsigned char *top;
   task_t *task = NULL;
   task_t *prev_task = NULL;
 
@@ -89,34 +517,78 @@ int task_create(const char *name, void (*func)(void*),
       stack_size = CONFIG_STACK_DEFAULT_SIZE;
     }
 
-  /* TODO Find first a free stack space which fulfill the space
-   * required for the stack size of this task.
+  /* Find room for the task control block, placed on top, and its stack.
+   * The first task, the kernel, starts the task area at the stack head.
    */
 
-  id = 0;
-  stack_used = 0;
-  task = (task_t*) g_task_list_head;
+  size = stack_size + TASK_STACK_CANARY_SIZE + sizeof(task_t);
+
+  disable_interrupts();
+
+  if (!g_task_list_head)
+    {
+      g_task_break = (unsigned char*) g_stack_head + 1;
+    }
+
+  /* Take a free slot, the kernel gets slot 0, thus ID 0. */
+
+  for (slot = 0; slot < CONFIG_TASK_MAX; slot++)
+    {
+      if (!g_task_table[slot])
+        {
+          break;
+        }
+    }
 
-  while (task)
+  if (slot == CONFIG_TASK_MAX)
     {
-      stack_used += task->stack_size + sizeof(task_t);
-      prev_task = task;
-      task = task->next;
-      id++;
+      enable_interrupts();
+      return 0;
     }
 
+  top = task_region_alloc_crit(&size);
+  if (!top)
+    {
+      enable_interrupts();
+      return 0;
+    }
+
+  task = (task_t*) (top - sizeof(task_t));
+  g_task_table[slot] = task;
+  enable_interrupts();
+
   /* Setup the task. */
 
-  task = (task_t*) (g_stack_head - stack_used - sizeof(task_t) + 1);
   task->next = NULL;
-  task->id = id;
+  task->id = ((unsigned int) g_task_generation[slot] << TASK_ID_SLOT_BITS) |
+             slot;
   task->arg = arg;
   task->state = TASK_STATE_READY;
-  task->stack_size = stack_size;
-  task->stack_pointer = (unsigned char*) (g_stack_head - stack_used - sizeof(task_t));
+  task->priority = CONFIG_TASK_DEFAULT_PRIORITY;
+  task->base_priority = CONFIG_TASK_DEFAULT_PRIORITY;
+  task->quantum = CONFIG_TASK_DEFAULT_QUANTUM;
+  task->slice = 0;
+  task->flags = 0;
+  task->wait_obj = NULL;
+  task->wait_value = 0;
+  task->wait_opts = 0;
+  task->wait_data = NULL;
+  task->mutex_held = NULL;
+  task->queue_next = NULL;
+  task->sleep_next = NULL;
+  task->stack_size = size - sizeof(task_t);
+  task->stack_pointer = (unsigned char*) task - 1;
   kstrncpy(task->name, name, CONFIG_TASK_MAX_NAME + 1);
 
-  /* Make previous task to point to this new one. */
+  /* Make the last task to point to this new one. */
+
+  disable_interrupts();
+
+  prev_task = (task_t*) g_task_list_head;
+  while (prev_task && prev_task->next)
+    {
+      prev_task = prev_task->next;
+    }
 
   if (prev_task)
     {
@@ -131,39 +603,182 @@ int task_create(const char *name, void (*func)(void*),
     {
       g_task_list_head = task;
     }
+  enable_interrupts();
 
-  /* Clear stack for the new task. */
+  /* Prepare the stack. By default it is cleared, painted for measuring
+   * its usage, or left as it is for a faster start. The initial frame is
+   * cleared anyway, below.
+   */
 
-  for (i = 0; i < stack_size; i++)
-    {
-      *(task->stack_pointer - i) = 0;
-    }
+#if defined(CONFIG_STACK_PAINT)
+  kmemset(task->stack_pointer - task->stack_size + 1, CONFIG_STACK_PAINT_BYTE,
+          task->stack_size);
+#elif !defined(CONFIG_STACK_INIT_LAZY)
+  kmemset(task->stack_pointer - task->stack_size + 1, 0, task->stack_size);
+#endif
+
+#ifdef CONFIG_STACK_CHECK
+  *(unsigned int*) ((unsigned char*) task - task->stack_size) =
+      TASK_STACK_CANARY;
+#endif
 
   /* Since the tasks are always executed with context-switch and NOT by simply
    * calling the function, here a clean context is created onto the stack
    * and the function pointer set as the return address.
    *
    * Thus, at first run, the registers are popped from the stack,
-   * containing zeroes, since they were previously cleared, then the returning
-   * address represents actually the function pointer, which in this case
-   * enter to function itself for the first run.
+   * containing zeroes, except the argument given to the task function,
+   * then the returning address represents actually the function pointer,
+   * which in this case enter to function itself for the first run.
    */
 
   //TODO these are architecture dependent. Move them in arch!!
 
+  /* Returning from the task function enters into task_exit(). */
+
+  *task->stack_pointer-- = ((unsigned char) ((unsigned int)task_exit));
+  *task->stack_pointer-- = (unsigned char) (((unsigned int)task_exit) >> 8);
+
   /* Put the return address to point to task function pointer. */
 
   *task->stack_pointer-- = ((unsigned char) ((unsigned int)func));
   *task->stack_pointer-- = (unsigned char) (((unsigned int)func) >> 8);
 
-  /* Simulate, clean registers were pushed already onto the stack. */
+  /* Simulate, clean registers were pushed already onto the stack, as
+   * a full frame carrying the argument.
+   */
+
+  task->stack_pointer -= CONTEXT_FRAME_FULL_SIZE;
+  kmemset(task->stack_pointer + 1, 0, CONTEXT_FRAME_FULL_SIZE);
+  task->stack_pointer[1] = CONTEXT_FRAME_FULL;
+  task->stack_pointer[1 + CONTEXT_FRAME_R24] =
+      (unsigned char) ((unsigned int) arg);
+  task->stack_pointer[1 + CONTEXT_FRAME_R25] =
+      (unsigned char) (((unsigned int) arg) >> 8);
 
-  task->stack_pointer -= 32 + 1; // R0-R31 + SREG
+  /* The kernel is never scheduled, only the other tasks are queued. */
+
+  if (task != g_task_list_head)
+    {
+      disable_interrupts();
+      sched_ready_insert(task);
+      enable_interrupts();
+    }
 
   return 1;
 }
 
 
+/****************************************************************************
+ * Name: task_stack_check_crit
+ *
+ * Description:
+ *    Verify the stack canary of a task which is being switched out. If it
+ *    was overwritten, the task is stopped and the overflow is reported.
+ *
+ * Input Parameters:
+ *    task - Task just switched out.
+ *
+ * Returned Value:
+ *    1 - If the stack is intact.
+ *    0 - If the stack has overflowed.
+ *
+ * Assumptions:
+ *    Called from critical section, when CONFIG_STACK_CHECK is defined.
+ *
+ ****************************************************************************/
+
+int task_stack_check_crit(task_t *task)
+{
+  unsigned int *canary;
+
+  canary = (unsigned int*) ((unsigned char*) task - task->stack_size);
+  if (*canary == TASK_STACK_CANARY)
+    {
+      return 1;
+    }
+
+  /* Already reported, or destroyed by itself thus about to be reclaimed,
+   * not being a valid event data anymore.
+   */
+
+  if ((task->flags & TASK_FLAG_OVERFLOW) || task->state == TASK_STATE_EXITED)
+    {
+      return 0;
+    }
+
+  /* Its memory cannot be trusted anymore, thus it is not reclaimed. */
+
+  task_cancel_wait_crit(task);
+
+  task->flags |= TASK_FLAG_OVERFLOW;
+  task->state = TASK_STATE_EXITED;
+
+  /* If the event buffer is full, the task reaper posts the report later. */
+
+  if (!kput_event_crit(KERNEL_EVENT_STACK_OVERFLOW, task))
+    {
+      task->queue_next = g_task_overflow_head;
+      g_task_overflow_head = task;
+      kput_event_once_crit(KERNEL_EVENT_TASK_EXITED);
+    }
+
+  return 0;
+}
+
+
+/****************************************************************************
+ * Name: task_stack_usage
+ *
+ * Description:
+ *    Get the peak stack usage of a task, found from the painted pattern.
+ *
+ * Input Parameters:
+ *    id - Given task ID. Zero for the current task.
+ *
+ * Returned Value:
+ *    Largest number of stack bytes used so far.
+ *    -1 - For errors, or if CONFIG_STACK_PAINT is not defined.
+ *
+ * Assumptions:
+ *    A function which reserved stack without writing it is not accounted.
+ *
+ ****************************************************************************/
+
+int task_stack_usage(int id)
+{
+#ifdef CONFIG_STACK_PAINT
+  task_t *task;
+  unsigned char *ptr;
+
+  if (!id)
+    {
+      id = task_getid();
+    }
+
+  task = task_getby_id(id);
+
+  if (!task)
+    {
+      return -1;
+    }
+
+  /* The stack grows downwards, the lowest written byte is the peak. */
+
+  ptr = (unsigned char*) task - task->stack_size + TASK_STACK_CANARY_SIZE;
+  while (ptr < (unsigned char*) task && *ptr == CONFIG_STACK_PAINT_BYTE)
+    {
+      ptr++;
+    }
+
+  return (unsigned char*) task - ptr;
+#else
+  (void) id;
+  return -1;
+#endif
+}
+
+
 /****************************************************************************
  * Name: task_getnext
  *
@@ -221,7 +836,7 @@ int task_getnext(task_t **task)
  * Name: task_getby_id
  *
  * Description:
- *    Get a pointer to a task specifying the task id.
+ *    Get a pointer to a task specifying the task id, in constant time.
  *
  * Input Parameters:
  *    id - Given task ID.
@@ -236,19 +851,30 @@ int task_getnext(task_t **task)
 
 task_t *task_getby_id(int id)
 {
-  task_t *task = NULL;
+  task_t *task;
+  unsigned char slot;
 
   if (!id)
     {
       return NULL;
     }
 
-  while (task_getnext(&task))
+  /* The slot bits can address more slots than the table has, when
+   * CONFIG_TASK_MAX is not a power of two.
+   */
+
+  slot = id & TASK_ID_SLOT_MASK;
+  if (slot >= CONFIG_TASK_MAX)
     {
-      if (task->id == id)
-        {
-          break;
-        }
+      return NULL;
+    }
+
+  /* A stale ID has another generation than the task into its slot. */
+
+  task = g_task_table[slot];
+  if (task && task->id != (unsigned int) id)
+    {
+      return NULL;
     }
 
   return task;
@@ -364,7 +990,19 @@ int task_resume(int id)
     {
       if (task->state == TASK_STATE_PAUSED)
         {
-          task->state = TASK_STATE_RESUMED;
+          /* Restore the state before pausing, a task which was
+           * ready or running goes back into the ready queue.
+           */
+
+          task->state = task->last_state;
+          if (task->state == TASK_STATE_READY ||
+              task->state == TASK_STATE_RUNNING)
+            {
+              task->state = TASK_STATE_READY;
+              disable_interrupts();
+              sched_ready_insert(task);
+              enable_interrupts();
+            }
           ret = 1;
         }
     }
@@ -405,6 +1043,11 @@ int task_pause(int id)
 
   if (task)
     {
+      if (task->state == TASK_STATE_READY)
+        {
+          sched_ready_remove(task);
+        }
+
       task->last_state = task->state;
       task->state = TASK_STATE_PAUSED;
       return 1;
@@ -418,23 +1061,26 @@ int task_pause(int id)
  * Name: task_destroy
  *
  * Description:
- *    Destroy a task specifying the task id.
+ *    Destroy a task specifying the task id, its memory being reused by the
+ *    next created tasks.
  *
  * Input Parameters:
- *    id - Given task ID.
+ *    id - Given task ID. Zero for the current task.
  *
  * Returned Value:
  *    1 - For success.
  *    0 - For errors.
+ *    For the current task, it does not return on success.
  *
  * Assumptions:
+ *    A task holding a mutex, or waiting for a mutex, a message queue or a
+ *    mailbox cannot be destroyed.
+ *    The kernel task cannot be destroyed.
  *
  ****************************************************************************/
 
 int task_destroy(int id)
 {
-  // TODO Not supported yet -> Removing from stack.
-#if 0
   task_t *task = NULL;
 
   if (!id)
@@ -444,19 +1090,33 @@ int task_destroy(int id)
 
   task = task_getby_id(id);
 
-  if (task)
+  if (!task || task->mutex_held)
     {
-      /* Remove task id, task name and set state to EXITED,
-       * thus others should not be able to find this task
-       * anymore by name or id.
-       */
+      return 0;
+    }
+
+  disable_interrupts();
+  if (!task_unlink_crit(task))
+    {
+      enable_interrupts();
+      return 0;
+    }
 
-      task->id = 0;
-      task->state = TASK_STATE_EXITED;
-      kmemset(task->name, 0, CONFIG_TASK_MAX_NAME + 1);
+  if (task != g_running_task)
+    {
+      task_release_crit(task);
+      enable_interrupts();
       return 1;
     }
-#endif
+
+  /* Still running on its own stack, thus the kernel reclaims it. */
+
+  task->queue_next = g_task_exited_head;
+  g_task_exited_head = task;
+  kput_event_once_crit(KERNEL_EVENT_TASK_EXITED);
+  enable_interrupts();
+
+  context_switch_to_kernel();
   return 0;
 }
 
@@ -490,16 +1150,34 @@ int task_sleep(unsigned int id, const unsigned int ticks)
 
   task = task_getby_id(id);
 
-  if (task)
+  if (!task)
     {
-      //TODO only if ready or running
-      task->state = TASK_STATE_SLEEP;
-      task->wakeup_ticks = ticks + g_systicks; // TODO this in critical section
+      return 0;
+    }
 
-      /* FIXME Simulate blocking function.
-       * TODO Implement blocking functions.
-       */
+  /* Only a ready or running task can be put to sleep. */
 
+  disable_interrupts();
+  if (task->state == TASK_STATE_READY)
+    {
+      sched_ready_remove(task);
+    }
+  else if (task->state != TASK_STATE_RUNNING)
+    {
+      enable_interrupts();
+      return 0;
+    }
+
+  task->state = TASK_STATE_SLEEP;
+  sleepq_insert_crit(task, ticks);
+  enable_interrupts();
+
+  /* FIXME Simulate blocking function.
+   * TODO Implement blocking functions.
+   */
+
+  if (task == g_running_task)
+    {
       context_switch_to_kernel();
     }
 
@@ -507,6 +1185,102 @@ int task_sleep(unsigned int id, const unsigned int ticks)
 }
 
 
+/****************************************************************************
+ * Name: task_setpriority
+ *
+ * Description:
+ *    Change the priority of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    id - Given task ID.
+ *    priority - New priority, 0 is the highest.
+ *               See, CONFIG_TASK_PRIORITIES.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    A ready task is moved at the end of its new priority queue.
+ *    While the task holds a mutex, its priority is not lowered under the
+ *    priority of the tasks waiting for that mutex.
+ *
+ ****************************************************************************/
+
+int task_setpriority(int id, unsigned char priority)
+{
+  task_t *task;
+
+  if (priority >= CONFIG_TASK_PRIORITIES)
+    {
+      return 0;
+    }
+
+  if (!id)
+    {
+      id = task_getid();
+    }
+
+  task = task_getby_id(id);
+
+  if (!task)
+    {
+      return 0;
+    }
+
+  /* The effective priority also accounts the inherited one. */
+
+  disable_interrupts();
+  task->base_priority = priority;
+  mutex_priority_update(task);
+  enable_interrupts();
+
+  return 1;
+}
+
+
+/****************************************************************************
+ * Name: task_setquantum
+ *
+ * Description:
+ *    Change the time slice of a task specifying the task id.
+ *
+ * Input Parameters:
+ *    id - Given task ID.
+ *    ticks - Number of ticks the task can run before being preempted.
+ *            Zero means the task is never preempted.
+ *
+ * Returned Value:
+ *    1 - For success.
+ *    0 - For errors.
+ *
+ * Assumptions:
+ *    Used only when CONFIG_PREEMPTION is defined. The new value is
+ *    applied the next time the task is run.
+ *
+ ****************************************************************************/
+
+int task_setquantum(int id, unsigned char ticks)
+{
+  task_t *task;
+
+  if (!id)
+    {
+      id = task_getid();
+    }
+
+  task = task_getby_id(id);
+
+  if (!task)
+    {
+      return 0;
+    }
+
+  task->quantum = ticks;
+  return 1;
+}
+
+
 /****************************************************************************
  * Name: task_getid
  *
@@ -6,8 +6,10 @@
  */
 
 #include "arch.h"
+#include "cpu.h"
 #include "klib.h"
 #include "kernel_api.h"
+#include "scheduler.h"
 
 
 //TODO maybe long long? or other approach!
@@ -15,6 +17,36 @@
 volatile unsigned long g_systicks;
 
 
+/* Sleep Queue
+ *
+ * Sleeping tasks are linked through task->sleep_next, sorted by their
+ * wake-up time. Each task stores only the number of ticks after the
+ * previous task in queue (delta), the first one being relative to the
+ * last systick accounted by the queue. Thus, a tick only looks at the
+ * head of queue, no matter how many tasks are sleeping.
+ */
+
+static task_t *g_sleep_head;
+static unsigned long g_sleep_ticks;
+
+static void sleepq_handler(kernel_event_t *event);
+
+/* Handler of KERNEL_EVENT_IRQ_SYSTICK, subscribed by sleepq_init(). */
+
+static kevent_handler_t g_sleepq_handler = { sleepq_handler, NULL };
+
+
+/* Wake up the sleeping tasks which reached their time. Only the head
+ * of the sleep queue is checked, not every sleeping task.
+ */
+
+static void sleepq_handler(kernel_event_t *event)
+{
+  (void) event;
+  sleepq_expire();
+}
+
+
 void reset_watchdog(void)
 {
   arch_reset_watchdog();
@@ -45,10 +77,45 @@ void configure_watchdog(void)
 }
 
 
+/* Ticks are accounted into g_systicks, thus a single pending systick event
+ * is enough, no matter how many ticks elapsed till it is consumed.
+ */
+
 void systick(void)
 {
   g_systicks++;
-  kput_event_crit(KERNEL_EVENT_IRQ_SYSTICK, NULL);
+  kput_event_once_crit(KERNEL_EVENT_IRQ_SYSTICK);
+}
+
+
+/****************************************************************************
+ * Name: systick_add
+ *
+ * Description:
+ *    Account many elapsed ticks in one step, producing at most one
+ *    systick event. Used by tickless mode, where the systick timer does not
+ *    interrupt the cpu on every tick.
+ *
+ * Input Parameters:
+ *    ticks - Number of elapsed ticks.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    This should be called only from critical section or ISR context.
+ *
+ ****************************************************************************/
+
+void systick_add(unsigned int ticks)
+{
+  if (!ticks)
+    {
+      return;
+    }
+
+  g_systicks += ticks;
+  kput_event_once_crit(KERNEL_EVENT_IRQ_SYSTICK);
 }
 
 
@@ -56,3 +123,313 @@ unsigned long getsysticks(void)
 {
   return g_systicks;
 }
+
+
+/****************************************************************************
+ * Name: sleepq_init
+ *
+ * Description:
+ *    Empty the sleep queue and subscribe it to the systick events.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called once from kernel initialization.
+ *
+ ****************************************************************************/
+
+void sleepq_init(void)
+{
+  g_sleep_head = NULL;
+  g_sleep_ticks = 0;
+
+  kernel_subscribe(KERNEL_EVENT_IRQ_SYSTICK, &g_sleepq_handler);
+}
+
+
+/****************************************************************************
+ * Name: sleepq_insert_crit
+ *
+ * Description:
+ *    Insert a task into the sleep queue, sorted by its wake-up time.
+ *    Tasks waking at the same tick are kept in insertion order.
+ *
+ *    A task in any blocked state can be inserted, thus bounding its wait.
+ *    When the time is reached, a waiting task is removed from the object
+ *    it waits on and marked with TASK_FLAG_TIMEDOUT.
+ *
+ * Input Parameters:
+ *    task - Task to be put to sleep.
+ *    ticks - Number of ticks to sleep, starting from now.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section, in task or kernel context, not from ISR.
+ *    The task must not be into the sleep queue already.
+ *
+ ****************************************************************************/
+
+void sleepq_insert_crit(task_t *task, unsigned int ticks)
+{
+  task_t *prev = NULL;
+  task_t *node;
+  unsigned long delta;
+
+  if (!task)
+    {
+      return;
+    }
+
+  /* Ticks elapsed since the queue was last updated are added, since the
+   * first delta is relative to that moment.
+   */
+
+  delta = ticks + (g_systicks - g_sleep_ticks);
+
+  /* Find the position, consuming the deltas of the earlier tasks. */
+
+  node = g_sleep_head;
+  while (node && node->wakeup_delta <= delta)
+    {
+      delta -= node->wakeup_delta;
+      prev = node;
+      node = node->sleep_next;
+    }
+
+  task->wakeup_delta = (unsigned int) delta;
+  task->sleep_next = node;
+  task->flags |= TASK_FLAG_SLEEPQ;
+
+  /* The following task is now relative to the inserted one. */
+
+  if (node)
+    {
+      node->wakeup_delta -= (unsigned int) delta;
+    }
+
+  if (prev)
+    {
+      prev->sleep_next = task;
+    }
+  else
+    {
+      g_sleep_head = task;
+    }
+}
+
+
+/****************************************************************************
+ * Name: sleepq_insert
+ *
+ * Description:
+ *    Insert a task into the sleep queue, see sleepq_insert_crit().
+ *
+ * Input Parameters:
+ *    task - Task to be put to sleep.
+ *    ticks - Number of ticks to sleep, starting from now.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from task or kernel context, not from ISR.
+ *
+ ****************************************************************************/
+
+void sleepq_insert(task_t *task, unsigned int ticks)
+{
+  disable_interrupts();
+  sleepq_insert_crit(task, ticks);
+  enable_interrupts();
+}
+
+
+/****************************************************************************
+ * Name: sleepq_remove_crit
+ *
+ * Description:
+ *    Remove a task from the sleep queue before its time, for example when
+ *    the object it waits on was given. Its remaining delta is handed to
+ *    the following task.
+ *
+ * Input Parameters:
+ *    task - Task to be removed.
+ *
+ * Returned Value:
+ *    none
+ *
+ * Assumptions:
+ *    Called from critical section or ISR.
+ *    Nothing is done if the task is not into the sleep queue, otherwise
+ *    the queue is walked up to the task.
+ *
+ ****************************************************************************/
+
+void sleepq_remove_crit(task_t *task)
+{
+  task_t **link;
+
+  if (!task || !(task->flags & TASK_FLAG_SLEEPQ))
+    {
+      return;
+    }
+
+  for (link = &g_sleep_head; *link; link = &(*link)->sleep_next)
+    {
+      if (*link == task)
+        {
+          *link = task->sleep_next;
+          if (task->sleep_next)
+            {
+              task->sleep_next->wakeup_delta += task->wakeup_delta;
+            }
+
+          break;
+        }
+    }
+
+  task->sleep_next = NULL;
+  task->wakeup_delta = 0;
+  task->flags &= ~TASK_FLAG_SLEEPQ;
+}
+
+
+/****************************************************************************
+ * Name: sleepq_next_ticks
+ *
+ * Description:
+ *    Get the number of ticks until the first sleeping task has to be
+ *    woken up.
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    0 - If there is no sleeping task.
+ *    Otherwise, number of ticks, at least one.
+ *
+ * Assumptions:
+ *    Called from kernel context, before going idle.
+ *
+ ****************************************************************************/
+
+unsigned int sleepq_next_ticks(void)
+{
+  unsigned long elapsed;
+  unsigned int delta;
+
+  /* The head can be removed by ISR, when its timed wait ends. */
+
+  disable_interrupts();
+  if (!g_sleep_head)
+    {
+      enable_interrupts();
+      return 0;
+    }
+
+  elapsed = g_systicks - g_sleep_ticks;
+  delta = g_sleep_head->wakeup_delta;
+  enable_interrupts();
+
+  if (delta <= elapsed)
+    {
+      return 1;
+    }
+
+  return delta - (unsigned int) elapsed;
+}
+
+
+/****************************************************************************
+ * Name: sleepq_expire
+ *
+ * Description:
+ *    Account the ticks elapsed since the last call and wake up the tasks
+ *    which reached their time, marking them as READY. Timed waits are
+ *    ended here, see sleepq_insert_crit().
+ *
+ * Input Parameters:
+ *    none
+ *
+ * Returned Value:
+ *    1 - If at least one task was woken up.
+ *    0 - If no task was woken up.
+ *
+ * Assumptions:
+ *    Called from kernel context, by the KERNEL_EVENT_IRQ_SYSTICK handler.
+ *    The work is proportional to the number of woken tasks.
+ *
+ ****************************************************************************/
+
+int sleepq_expire(void)
+{
+  task_t *task;
+  unsigned long now;
+  unsigned long elapsed;
+  int woken = 0;
+
+  /* Blocking functions insert tasks from task context, thus the queue
+   * is walked having interrupts disabled.
+   */
+
+  disable_interrupts();
+  now = g_systicks;
+
+  elapsed = now - g_sleep_ticks;
+  g_sleep_ticks = now;
+
+  while ((task = g_sleep_head))
+    {
+      /* Head is not due yet, only consume the elapsed ticks. */
+
+      if (task->wakeup_delta > elapsed)
+        {
+          task->wakeup_delta -= (unsigned int) elapsed;
+          break;
+        }
+
+      elapsed -= task->wakeup_delta;
+
+      /* Remove it from queue and make it ready. A task waiting on an
+       * object is removed from that object first.
+       */
+
+      g_sleep_head = task->sleep_next;
+      task->sleep_next = NULL;
+      task->wakeup_delta = 0;
+      task->flags &= ~TASK_FLAG_SLEEPQ;
+
+      switch (task->state)
+        {
+          case TASK_STATE_SEM_WAIT:
+            sem_wait_cancel_crit(task);
+            task->flags |= TASK_FLAG_TIMEDOUT;
+            break;
+
+          case TASK_STATE_FLAGS_WAIT:
+            eventflags_wait_cancel_crit(task);
+            task->flags |= TASK_FLAG_TIMEDOUT;
+            break;
+
+          case TASK_STATE_SLEEP:
+            break;
+
+          default:
+            continue;
+        }
+
+      task->state = TASK_STATE_READY;
+      sched_ready_insert(task);
+      woken = 1;
+    }
+
+  enable_interrupts();
+
+  return woken;
+}